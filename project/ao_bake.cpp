@@ -0,0 +1,116 @@
+#include "ao_bake.h"
+
+#include <cmath>
+#include <algorithm>
+
+// brightness by how many of the four tiles at a corner are solid
+static const float AO_LEVELS[4] = { 1.0f, 0.75f, 0.55f, 0.4f };
+
+static bool solidTile(const Map& map, const GameState& state, int row, int col) {
+	// outside the map counts as open, the edge of the level has no walls unless the scene has them
+	if (row < 0 || row >= map.height || col < 0 || col >= map.width) {
+		return false;
+	}
+	char c = map.grid[row][col];
+	if (c == 'W') {
+		return true;
+	}
+	if (c >= 'A' && c <= 'E') {
+		for (size_t d = 0; d < map.doors.size(); d++) {
+			if (map.doors[d].x == col && map.doors[d].y == row) {
+				return !state.doorUnlocked[d];
+			}
+		}
+	}
+	return false;
+}
+
+static bool bakedSolid(const AOBake& ao, int row, int col) {
+	if (row < 0 || row >= ao.height || col < 0 || col >= ao.width) {
+		return false;
+	}
+	return ao.solid[row * ao.width + col] != 0;
+}
+
+// corner (r, c) is shared by tiles (r-1, c-1), (r-1, c), (r, c-1) and (r, c)
+static float bakeCorner(const AOBake& ao, int r, int c) {
+	bool topLeft = bakedSolid(ao, r - 1, c - 1);
+	bool topRight = bakedSolid(ao, r - 1, c);
+	bool bottomLeft = bakedSolid(ao, r, c - 1);
+	bool bottomRight = bakedSolid(ao, r, c);
+	int solid = topLeft + topRight + bottomLeft + bottomRight;
+	// two solids touching only at the corner pinch the open tiles between them as
+	// much as three would (the usual voxel ao "both sides" case)
+	if (solid == 2 && topLeft == bottomRight) {
+		solid = 3;
+	}
+	return AO_LEVELS[std::min(solid, 3)];
+}
+
+void bakeAO(AOBake& ao, const Map& map, const GameState& state, ThreadPool& pool) {
+	ao.width = map.width;
+	ao.height = map.height;
+	ao.corners.assign((map.width + 1) * (map.height + 1), 1.0f);
+	ao.solid.assign(map.width * map.height, 0);
+	ao.bakedDoorUnlocked = state.doorUnlocked;
+
+	parallelFor(pool, 0, map.height, [&](int rowBegin, int rowEnd) {
+		for (int r = rowBegin; r < rowEnd; r++) {
+			for (int c = 0; c < map.width; c++) {
+				ao.solid[r * map.width + c] = solidTile(map, state, r, c);
+			}
+		}
+	});
+	parallelFor(pool, 0, map.height + 1, [&](int rowBegin, int rowEnd) {
+		for (int r = rowBegin; r < rowEnd; r++) {
+			for (int c = 0; c <= map.width; c++) {
+				ao.corners[r * (map.width + 1) + c] = bakeCorner(ao, r, c);
+			}
+		}
+	});
+}
+
+void rebakeTileAO(AOBake& ao, const Map& map, const GameState& state, int row, int col) {
+	ao.solid[row * map.width + col] = solidTile(map, state, row, col);
+	for (int r = row; r <= row + 1; r++) {
+		for (int c = col; c <= col + 1; c++) {
+			ao.corners[r * (map.width + 1) + c] = bakeCorner(ao, r, c);
+		}
+	}
+}
+
+void syncDoorAO(AOBake& ao, const Map& map, const GameState& state, std::vector<int>& changedTiles) {
+	if (ao.bakedDoorUnlocked.size() != state.doorUnlocked.size()) {
+		ao.bakedDoorUnlocked = state.doorUnlocked;
+		return;
+	}
+	for (size_t d = 0; d < map.doors.size(); d++) {
+		if (ao.bakedDoorUnlocked[d] == state.doorUnlocked[d]) continue;
+		ao.bakedDoorUnlocked[d] = state.doorUnlocked[d];
+		rebakeTileAO(ao, map, state, map.doors[d].y, map.doors[d].x);
+		changedTiles.push_back(map.doors[d].y * map.width + map.doors[d].x);
+	}
+}
+
+float cornerAO(const AOBake& ao, float x, float y) {
+	// world y counts up from the bottom, corner rows count down from the top
+	int c = std::min(std::max((int)floorf(x + 0.5f), 0), ao.width);
+	int r = std::min(std::max(ao.height - (int)floorf(y + 0.5f), 0), ao.height);
+	return ao.corners[r * (ao.width + 1) + c];
+}
+
+float wallBaseAO(const AOBake& ao, float x, float y, float nx, float ny) {
+	float cx = floorf(x + 0.5f);
+	float cy = floorf(y + 0.5f);
+	// centers of the two tiles on the open side of the face touching this corner, one
+	// straight in front of the wall and one diagonally past the corner
+	int solid = 0;
+	for (int side = -1; side <= 1; side += 2) {
+		float tx = cx + 0.5f * nx - 0.5f * side * ny;
+		float ty = cy + 0.5f * ny + 0.5f * side * nx;
+		int col = (int)floorf(tx);
+		int row = ao.height - 1 - (int)floorf(ty);
+		solid += bakedSolid(ao, row, col);
+	}
+	return AO_LEVELS[solid];
+}
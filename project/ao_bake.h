@@ -0,0 +1,37 @@
+#pragma once
+#include <vector>
+
+#include "sim.h"
+#include "thread_pool.h"
+
+// BAKED AMBIENT OCCLUSION
+// the level is a grid, so how boxed in a spot on the floor is only depends on the tiles
+// around it. every tile corner gets one brightness value from the (up to) four tiles that
+// meet there, walls and locked doors count as solid. the floor vertices sitting on a corner
+// copy its value when the chunk meshes are built, so shading just multiplies by a vertex
+// attribute and costs nothing extra at runtime. wall bases can't use the corner value, it
+// would count the wall as its own occluder, so they look at the tiles in front of the face.
+struct AOBake {
+	int width = 0;   // in tiles, there are (width + 1) x (height + 1) corners
+	int height = 0;
+	// brightness per corner, 1 = open, lower = more occluded. corner (r, c) is the top left
+	// corner of tile (r, c) in grid order (row 0 is the top line of the scene file)
+	std::vector<float> corners;
+	// 1 for every solid tile, same grid order
+	std::vector<unsigned char> solid;
+	// door state the corners were last baked with, lines up with map.doors
+	std::vector<bool> bakedDoorUnlocked;
+};
+
+// bake every corner of the map, rows are shared out over the pool
+void bakeAO(AOBake& ao, const Map& map, const GameState& state, ThreadPool& pool);
+// re-bake the four corners of one tile after it changed
+void rebakeTileAO(AOBake& ao, const Map& map, const GameState& state, int row, int col);
+// re-bake around every door whose locked state changed since the last bake. the tiles
+// whose occlusion changed are added to changedTiles as row * width + col
+void syncDoorAO(AOBake& ao, const Map& map, const GameState& state, std::vector<int>& changedTiles);
+// occlusion at world position (x, y), snapped to the nearest tile corner
+float cornerAO(const AOBake& ao, float x, float y);
+// occlusion for a wall's bottom vertex at (x, y) on the face pointing along (nx, ny). only the
+// two tiles in front of the face that share the corner count, so a lone wall stays unshaded
+float wallBaseAO(const AOBake& ao, float x, float y, float nx, float ny);
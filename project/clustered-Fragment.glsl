@@ -0,0 +1,73 @@
+#version 150 core
+
+in vec3 Color;
+in vec3 vertNormal;
+in vec3 pos;
+in vec3 lightDir;
+in vec2 texcoord;
+in float ao;
+flat in int drawTexID;
+
+out vec4 outColor;
+
+uniform sampler2D tex0;
+uniform sampler2D tex1;
+
+// clustered point lights (see clusters.h)
+uniform samplerBuffer lightData;     // 2 texels per light: view space position + radius, color + intensity
+uniform usamplerBuffer clusterGrid;  // per cluster: offset into lightIndices, number of lights
+uniform usamplerBuffer lightIndices;
+uniform ivec3 clusterDims;
+uniform vec2 screenSize;
+uniform float clusterNear;
+uniform float clusterSliceScale;     // slices / log(far / near)
+
+const float ambient = .3;
+
+void main() {
+	vec3 color;
+	if (drawTexID == -1)
+		color = Color;
+	else if (drawTexID == 0)
+		color = texture(tex0, texcoord).rgb;
+	else if (drawTexID == 1)
+		color = texture(tex1, texcoord).rgb;
+	else {
+		outColor = vec4(1, 0, 0, 1);
+		return; //This was an error, stop lighting!
+	}
+
+	vec3 normal = normalize(vertNormal);
+	vec3 diffuseC = color * max(dot(-lightDir, normal), 0.0);
+	vec3 ambC = color * ambient;
+	vec3 viewDir = normalize(-pos); //We know the eye is at (0,0)!
+	vec3 reflectDir = reflect(viewDir, normal);
+	float spec = max(dot(reflectDir, lightDir), 0.0);
+	if (dot(-lightDir, normal) <= 0.0) spec = 0;
+	vec3 specC = .8 * vec3(1.0, 1.0, 1.0) * pow(spec, 4);
+
+	// find this fragment's cluster and only light it with the lights assigned there
+	ivec2 tile = ivec2(gl_FragCoord.xy / screenSize * vec2(clusterDims.xy));
+	tile = clamp(tile, ivec2(0), clusterDims.xy - 1);
+	int slice = clamp(int(log(-pos.z / clusterNear) * clusterSliceScale), 0, clusterDims.z - 1);
+	int cluster = (slice * clusterDims.y + tile.y) * clusterDims.x + tile.x;
+	uvec2 lightList = texelFetch(clusterGrid, cluster).xy;
+
+	// the floor is black, give it a little albedo so glows still show up on it
+	vec3 albedo = max(color, vec3(0.15));
+	vec3 pointC = vec3(0);
+	for (uint i = 0u; i < lightList.y; i++) {
+		int light = int(texelFetch(lightIndices, int(lightList.x + i)).r);
+		vec4 posRadius = texelFetch(lightData, light * 2);
+		vec4 colorIntensity = texelFetch(lightData, light * 2 + 1);
+		vec3 toLight = posRadius.xyz - pos;
+		float dist = length(toLight);
+		if (dist >= posRadius.w) continue;
+		float falloff = 1.0 - dist / posRadius.w;
+		falloff *= falloff;
+		pointC += albedo * colorIntensity.rgb * (colorIntensity.a * falloff * max(dot(normal, toLight / dist), 0.0));
+	}
+
+	// baked occlusion darkens the sky light, the glows are close enough to reach into corners
+	outColor = vec4((diffuseC + ambC) * ao + specC + pointC, 1.0);
+}
@@ -0,0 +1,49 @@
+#version 150 core
+
+in vec3 position;
+in vec3 inNormal;
+in vec2 inTexcoord;
+in float inAO;      // baked occlusion, 1 for models (see ao_bake.h)
+
+const vec3 inLightDir = normalize(vec3(-1, 1, -1));
+
+// per frame and per draw data streamed through a ring buffer (see stream_ring.h). a batch
+// of draws is one instanced call, each instance picks its record by gl_InstanceID.
+// the old per draw uniform path is uniform-Vertex.glsl
+const int MAX_DRAWS = 128;
+struct DrawRecord {
+	mat4 model;
+	vec4 colorTex;  // rgb color, texture id in w
+};
+layout(std140) uniform FrameData {
+	mat4 frameView;
+	mat4 frameProj;
+};
+layout(std140) uniform DrawData {
+	DrawRecord draws[MAX_DRAWS];
+};
+
+out vec3 Color;
+out vec3 vertNormal;
+out vec3 pos;       // view space, the point lights are uploaded in view space too
+out vec3 lightDir;
+out vec2 texcoord;
+out float ao;
+flat out int drawTexID;
+
+void main() {
+	mat4 M = draws[gl_InstanceID].model;
+	mat4 V = frameView;
+	mat4 P = frameProj;
+	Color = draws[gl_InstanceID].colorTex.rgb;
+	drawTexID = int(draws[gl_InstanceID].colorTex.w);
+
+	vec4 viewPos = V * M * vec4(position, 1.0);
+	gl_Position = P * viewPos;
+	pos = viewPos.xyz;
+	lightDir = (V * vec4(inLightDir, 0.0)).xyz;
+	vec4 norm4 = transpose(inverse(V * M)) * vec4(inNormal, 0.0);
+	vertNormal = normalize(norm4.xyz);
+	texcoord = inTexcoord;
+	ao = inAO;
+}
@@ -0,0 +1,139 @@
+#include "clusters.h"
+
+#include <cmath>
+#include <algorithm>
+
+// depth (positive distance in front of the camera) where slice k starts
+static float sliceDepth(const ClusterGrid& grid, int k) {
+	return grid.nearPlane * powf(grid.farPlane / grid.nearPlane, k / (float)CLUSTER_Z);
+}
+
+static int depthToSlice(const ClusterGrid& grid, float depth) {
+	if (depth <= grid.nearPlane) return 0;
+	int slice = (int)floorf(logf(depth / grid.nearPlane) * clusterSliceScale(grid));
+	return std::min(slice, CLUSTER_Z - 1);
+}
+
+float clusterSliceScale(const ClusterGrid& grid) {
+	return CLUSTER_Z / logf(grid.farPlane / grid.nearPlane);
+}
+
+void initClusterGrid(ClusterGrid& grid, float fovY, float aspect, float nearPlane, float farPlane) {
+	if (grid.fovY == fovY && grid.aspect == aspect && grid.nearPlane == nearPlane && grid.farPlane == farPlane) {
+		return;
+	}
+	grid.fovY = fovY;
+	grid.aspect = aspect;
+	grid.nearPlane = nearPlane;
+	grid.farPlane = farPlane;
+	grid.bounds.resize(NUM_CLUSTERS * 6);
+	grid.counts.assign(NUM_CLUSTERS, 0);
+	grid.offsetCount.assign(NUM_CLUSTERS * 2, 0);
+
+	float tanY = tanf(fovY / 2.0f);
+	float tanX = tanY * aspect;
+	for (int k = 0; k < CLUSTER_Z; k++) {
+		float zNear = sliceDepth(grid, k);
+		float zFar = sliceDepth(grid, k + 1);
+		for (int j = 0; j < CLUSTER_Y; j++) {
+			// tile edges in normalized device coordinates
+			float ny0 = -1.0f + 2.0f * j / CLUSTER_Y;
+			float ny1 = -1.0f + 2.0f * (j + 1) / CLUSTER_Y;
+			for (int i = 0; i < CLUSTER_X; i++) {
+				float nx0 = -1.0f + 2.0f * i / CLUSTER_X;
+				float nx1 = -1.0f + 2.0f * (i + 1) / CLUSTER_X;
+				// the tile is a frustum slice, so its box has to cover both the near and far face
+				float* b = &grid.bounds[((k * CLUSTER_Y + j) * CLUSTER_X + i) * 6];
+				b[0] = std::min(nx0 * tanX * zNear, nx0 * tanX * zFar);
+				b[1] = std::min(ny0 * tanY * zNear, ny0 * tanY * zFar);
+				b[2] = -zFar;
+				b[3] = std::max(nx1 * tanX * zNear, nx1 * tanX * zFar);
+				b[4] = std::max(ny1 * tanY * zNear, ny1 * tanY * zFar);
+				b[5] = -zNear;
+			}
+		}
+	}
+}
+
+// does the sphere touch the box
+static bool sphereHitsBox(const PointLight& light, const float* b) {
+	float dx = std::max(std::max(b[0] - light.x, 0.0f), light.x - b[3]);
+	float dy = std::max(std::max(b[1] - light.y, 0.0f), light.y - b[4]);
+	float dz = std::max(std::max(b[2] - light.z, 0.0f), light.z - b[5]);
+	return dx * dx + dy * dy + dz * dz <= light.radius * light.radius;
+}
+
+// range of tiles along one screen axis the sphere can cover. x / depth only changes in one
+// direction as depth grows, so checking the nearest and farthest depth is enough
+static void tileRange(float center, float radius, float dMin, float dMax, float tanHalf, int numTiles, int& first, int& last) {
+	float lo = std::min((center - radius) / (dMin * tanHalf), (center - radius) / (dMax * tanHalf));
+	float hi = std::max((center + radius) / (dMin * tanHalf), (center + radius) / (dMax * tanHalf));
+	first = std::max(0, (int)floorf((lo + 1.0f) * 0.5f * numTiles));
+	last = std::min(numTiles - 1, (int)floorf((hi + 1.0f) * 0.5f * numTiles));
+}
+
+// call visit(cluster) for every cluster of slices [sliceBegin, sliceEnd) the light touches
+template <typename Visit>
+static void forEachCluster(const ClusterGrid& grid, const PointLight& light, float tanX, float tanY, int sliceBegin, int sliceEnd, Visit visit) {
+	// view space looks down -z
+	float dMin = std::max(-light.z - light.radius, grid.nearPlane);
+	float dMax = std::min(-light.z + light.radius, grid.farPlane);
+	if (dMin > dMax) return; // entirely behind the camera or past the far plane
+
+	int k0 = std::max(depthToSlice(grid, dMin), sliceBegin);
+	int k1 = std::min(depthToSlice(grid, dMax), sliceEnd - 1);
+	if (k0 > k1) return;
+
+	int i0, i1, j0, j1;
+	tileRange(light.x, light.radius, dMin, dMax, tanX, CLUSTER_X, i0, i1);
+	tileRange(light.y, light.radius, dMin, dMax, tanY, CLUSTER_Y, j0, j1);
+
+	for (int k = k0; k <= k1; k++) {
+		for (int j = j0; j <= j1; j++) {
+			for (int i = i0; i <= i1; i++) {
+				int cluster = (k * CLUSTER_Y + j) * CLUSTER_X + i;
+				if (sphereHitsBox(light, &grid.bounds[cluster * 6])) {
+					visit(cluster);
+				}
+			}
+		}
+	}
+}
+
+void assignLights(ClusterGrid& grid, const std::vector<PointLight>& lights, ThreadPool& pool) {
+	float tanY = tanf(grid.fovY / 2.0f);
+	float tanX = tanY * grid.aspect;
+	const int sliceClusters = CLUSTER_Y * CLUSTER_X;
+
+	// every job owns a run of depth slices, so no two jobs ever write the same cluster.
+	// first count how many lights land in each cluster
+	parallelFor(pool, 0, CLUSTER_Z, [&](int sliceBegin, int sliceEnd) {
+		int* counts = &grid.counts[sliceBegin * sliceClusters];
+		std::fill(counts, counts + (sliceEnd - sliceBegin) * sliceClusters, 0);
+		for (const PointLight& light : lights) {
+			forEachCluster(grid, light, tanX, tanY, sliceBegin, sliceEnd, [&](int cluster) { grid.counts[cluster]++; });
+		}
+	});
+
+	// prefix sum over the counts gives every list its place in lightIndices
+	unsigned int total = 0;
+	grid.maxLights = 0;
+	for (int c = 0; c < NUM_CLUSTERS; c++) {
+		grid.offsetCount[c * 2] = total;
+		grid.offsetCount[c * 2 + 1] = grid.counts[c];
+		total += grid.counts[c];
+		grid.maxLights = std::max(grid.maxLights, grid.counts[c]);
+	}
+	grid.lightIndices.resize(total);
+
+	// then walk the same lights again and write each index into its slot, in light order
+	parallelFor(pool, 0, CLUSTER_Z, [&](int sliceBegin, int sliceEnd) {
+		int* counts = &grid.counts[sliceBegin * sliceClusters];
+		std::fill(counts, counts + (sliceEnd - sliceBegin) * sliceClusters, 0);
+		for (int l = 0; l < (int)lights.size(); l++) {
+			forEachCluster(grid, lights[l], tanX, tanY, sliceBegin, sliceEnd, [&](int cluster) {
+				grid.lightIndices[grid.offsetCount[cluster * 2] + grid.counts[cluster]++] = l;
+			});
+		}
+	});
+}
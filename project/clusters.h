@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+
+#include "thread_pool.h"
+
+// CLUSTERED LIGHTING
+// the view frustum is cut into CLUSTER_X x CLUSTER_Y tiles on screen and CLUSTER_Z slices
+// in depth (exponentially spaced, so slices near the camera are thin). every frame each
+// point light is added to the clusters its sphere touches, and the fragment shader only
+// loops over the lights of the cluster it falls in. lists have no length cap: lights are
+// counted per cluster first, a prefix sum over the counts gives every list its offset, and
+// a second pass writes the indices straight into place.
+// everything here is plain CPU work, uploading the results is up to the renderer.
+
+const int CLUSTER_X = 16;
+const int CLUSTER_Y = 9;
+const int CLUSTER_Z = 24;
+const int NUM_CLUSTERS = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+
+struct PointLight {
+	float x, y, z;    // position (view space when passed to assignLights)
+	float radius;     // no light at all past this distance
+	float r, g, b;
+	float intensity;
+};
+
+struct ClusterGrid {
+	float nearPlane = 0;
+	float farPlane = 0;
+	float fovY = 0;   // radians
+	float aspect = 0;
+	// view space bounding box of every cluster, 6 floats each (min xyz, max xyz)
+	std::vector<float> bounds;
+	// lights per cluster, counted in the first pass and used as write cursors in the second
+	std::vector<int> counts;
+
+	// packed result for the shader: offset and count into lightIndices for every cluster
+	std::vector<unsigned int> offsetCount;
+	std::vector<unsigned int> lightIndices;
+	int maxLights = 0; // longest list last assign, what the slowest fragment loops over
+};
+
+// (re)build the cluster bounds for a perspective projection. cheap to call every frame,
+// it only does the work when one of the parameters changed
+void initClusterGrid(ClusterGrid& grid, float fovY, float aspect, float nearPlane, float farPlane);
+// lights must already be in view space. slices are shared out over the pool
+void assignLights(ClusterGrid& grid, const std::vector<PointLight>& lights, ThreadPool& pool);
+// CLUSTER_Z / log(far / near), the shader uses this to find its slice from depth
+float clusterSliceScale(const ClusterGrid& grid);
@@ -0,0 +1,65 @@
+#include "dynamic_res.h"
+
+#include <cmath>
+#include <algorithm>
+
+// how fast the average follows new frames, about a quarter second at 60 fps
+const float AVERAGE_WEIGHT = 0.1f;
+// frames to wait after a change before judging the new scale
+const int SETTLE_FRAMES = 20;
+// go down when over the target by this much, up only with this much headroom. the gap
+// between the two keeps the scale from flipping back and forth every second
+const float DOWN_THRESHOLD = 1.05f;
+const float UP_THRESHOLD = 0.8f;
+
+static float snapScale(const DynamicRes& res, float scale) {
+	scale = roundf(scale / DYNAMIC_RES_STEP) * DYNAMIC_RES_STEP;
+	return std::min(std::max(scale, res.minScale), res.maxScale);
+}
+
+DynamicResDecision updateDynamicRes(DynamicRes& res, float frameMs) {
+	if (res.averageMs == 0) {
+		res.averageMs = frameMs;
+	}
+	res.averageMs += (frameMs - res.averageMs) * AVERAGE_WEIGHT;
+	res.framesSinceChange++;
+
+	if (!res.enabled || res.framesSinceChange < SETTLE_FRAMES) {
+		return DYNAMIC_RES_HOLD;
+	}
+
+	float next = res.scale;
+	if (res.averageMs > res.targetMs * DOWN_THRESHOLD) {
+		// at least one step, otherwise small overruns round back to the same scale
+		next = std::min(snapScale(res, res.scale * sqrtf(res.targetMs / res.averageMs)), res.scale - DYNAMIC_RES_STEP);
+	}
+	else if (res.averageMs < res.targetMs * UP_THRESHOLD) {
+		// one step at a time, a bad guess going up shows as a hitch
+		next = res.scale + DYNAMIC_RES_STEP;
+	}
+	next = snapScale(res, next);
+	if (next == res.scale) {
+		return DYNAMIC_RES_HOLD;
+	}
+
+	res.lastScale = res.scale;
+	res.lastAverageMs = res.averageMs;
+	res.changes++;
+	DynamicResDecision decision = next < res.scale ? DYNAMIC_RES_DOWN : DYNAMIC_RES_UP;
+	res.scale = next;
+	res.framesSinceChange = 0;
+	return decision;
+}
+
+void setDynamicResEnabled(DynamicRes& res, bool enabled) {
+	res.enabled = enabled;
+	if (!enabled) {
+		res.scale = res.maxScale;
+	}
+	res.framesSinceChange = 0;
+}
+
+void dynamicResSize(const DynamicRes& res, int windowWidth, int windowHeight, int& width, int& height) {
+	width = std::max(1, (int)(windowWidth * res.scale + 0.5f));
+	height = std::max(1, (int)(windowHeight * res.scale + 0.5f));
+}
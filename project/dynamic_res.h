@@ -0,0 +1,37 @@
+#pragma once
+
+// DYNAMIC RESOLUTION
+// the scene is drawn into an offscreen buffer at some fraction of the window size and
+// stretched to the window afterwards. this picks that fraction from measured frame times:
+// when frames run long the scale drops, when there is plenty of headroom it creeps back up.
+// pixel cost goes with scale squared, so a drop is sized from the square root of how far
+// over the target the frames are.
+struct DynamicRes {
+	float targetMs = 1000.0f / 60.0f;
+	float minScale = 0.5f;
+	float maxScale = 1.0f;
+	float scale = 1.0f;     // fraction of the window width and height the scene is drawn at
+	bool enabled = true;    // false locks the scale at maxScale
+
+	float averageMs = 0;    // smoothed frame time the decisions are made from
+	int framesSinceChange = 0;
+	// last decision, for the frame statistics
+	float lastScale = 1.0f;
+	float lastAverageMs = 0;
+	int changes = 0;
+};
+
+// every change is a multiple of this, so the scale settles instead of drifting by tiny steps
+const float DYNAMIC_RES_STEP = 0.05f;
+
+enum DynamicResDecision {
+	DYNAMIC_RES_HOLD,
+	DYNAMIC_RES_DOWN,
+	DYNAMIC_RES_UP
+};
+
+// feed one frame time in, returns what the controller did with the scale
+DynamicResDecision updateDynamicRes(DynamicRes& res, float frameMs);
+void setDynamicResEnabled(DynamicRes& res, bool enabled);
+// render size for a window of windowWidth x windowHeight at the current scale, never below 1
+void dynamicResSize(const DynamicRes& res, int windowWidth, int windowHeight, int& width, int& height);
@@ -0,0 +1,120 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include "file_watcher.h"
+
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+// how often the fallback checks modification times
+static const unsigned long long POLL_INTERVAL_MS = 250;
+
+static long long fileModTime(const std::string& path) {
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0) {
+		return 0;
+	}
+	return (long long)st.st_mtime;
+}
+
+bool initFileWatcher(FileWatcher& watcher) {
+	watcher.files.clear();
+#ifdef __linux__
+	watcher.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (watcher.fd < 0) {
+		printf("WARNING: inotify unavailable, falling back to polling for hot reload\n");
+	}
+#endif
+	return true;
+}
+
+bool watchFile(FileWatcher& watcher, const std::string& path) {
+	WatchedFile file;
+	file.path = path;
+	size_t slash = path.find_last_of("/\\");
+	if (slash == std::string::npos) {
+		file.dir = ".";
+		file.name = path;
+	}
+	else {
+		file.dir = path.substr(0, slash);
+		file.name = path.substr(slash + 1);
+	}
+	file.mtime = fileModTime(path);
+
+#ifdef __linux__
+	if (watcher.fd >= 0) {
+		// several files can share a directory, inotify hands back the same descriptor for it.
+		// no IN_CREATE, it fires before the editor has written anything and we'd load an empty file
+		file.wd = inotify_add_watch(watcher.fd, file.dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+		if (file.wd < 0) {
+			printf("ERROR: Could not watch %s for changes\n", file.dir.c_str());
+			return false;
+		}
+	}
+#endif
+	watcher.files.push_back(file);
+	return true;
+}
+
+static void addChanged(std::vector<std::string>& changed, const std::string& path) {
+	for (auto& p : changed) {
+		if (p == path) return;
+	}
+	changed.push_back(path);
+}
+
+std::vector<std::string> pollFileWatcher(FileWatcher& watcher, unsigned long long nowMs) {
+	std::vector<std::string> changed;
+
+#ifdef __linux__
+	if (watcher.fd >= 0) {
+		// drain every queued event, a single save usually produces more than one
+		alignas(struct inotify_event) char buffer[4096];
+		for (;;) {
+			ssize_t len = read(watcher.fd, buffer, sizeof(buffer));
+			if (len <= 0) break;
+			for (char* ptr = buffer; ptr < buffer + len;) {
+				const struct inotify_event* event = (const struct inotify_event*)ptr;
+				if (event->len > 0) {
+					for (auto& file : watcher.files) {
+						if (file.wd == event->wd && file.name == event->name) {
+							addChanged(changed, file.path);
+						}
+					}
+				}
+				ptr += sizeof(struct inotify_event) + event->len;
+			}
+		}
+		return changed;
+	}
+#endif
+
+	if (nowMs - watcher.lastPollMs < POLL_INTERVAL_MS) {
+		return changed;
+	}
+	watcher.lastPollMs = nowMs;
+	for (auto& file : watcher.files) {
+		long long mtime = fileModTime(file.path);
+		if (mtime != 0 && mtime != file.mtime) {
+			file.mtime = mtime;
+			addChanged(changed, file.path);
+		}
+	}
+	return changed;
+}
+
+void closeFileWatcher(FileWatcher& watcher) {
+#ifdef __linux__
+	if (watcher.fd >= 0) {
+		close(watcher.fd);
+	}
+#endif
+	watcher.fd = -1;
+	watcher.files.clear();
+}
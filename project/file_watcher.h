@@ -0,0 +1,27 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// watches a handful of files (scenes, shaders) for changes so they can be hot reloaded.
+// on linux this uses inotify on the parent directories, so editors that save by
+// writing a temp file and renaming it over the original are still picked up.
+// everywhere else it falls back to polling the file modification times.
+struct WatchedFile {
+	std::string path;   // path exactly as it was passed to watchFile()
+	std::string dir;    // parent directory of the file
+	std::string name;   // file name without the directory
+	int wd = -1;        // inotify watch descriptor of the parent directory
+	long long mtime = 0; // last seen modification time (polling fallback)
+};
+
+struct FileWatcher {
+	int fd = -1;
+	std::vector<WatchedFile> files;
+	unsigned long long lastPollMs = 0;
+};
+
+bool initFileWatcher(FileWatcher& watcher);
+bool watchFile(FileWatcher& watcher, const std::string& path);
+// never blocks, returns the paths (as passed to watchFile) that changed since the last call
+std::vector<std::string> pollFileWatcher(FileWatcher& watcher, unsigned long long nowMs);
+void closeFileWatcher(FileWatcher& watcher);
@@ -0,0 +1,136 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include "frame_writer.h"
+
+#include <chrono>
+
+// top row first, 3 bytes per pixel
+static void toRGB(const WriterJob& job, std::vector<unsigned char>& rgb) {
+	rgb.resize((size_t)job.width * job.height * 3);
+	unsigned char* out = rgb.data();
+	for (int y = 0; y < job.height; y++) {
+		const uint32_t* row = &job.pixels[(size_t)(job.bottomUp ? job.height - 1 - y : y) * job.width];
+		for (int x = 0; x < job.width; x++) {
+			*out++ = (row[x] >> 16) & 0xFF;
+			*out++ = (row[x] >> 8) & 0xFF;
+			*out++ = row[x] & 0xFF;
+		}
+	}
+}
+
+static void writeJob(FrameWriter& writer, const WriterJob& job, std::vector<unsigned char>& rgb) {
+	toRGB(job, rgb);
+	if (!job.filename.empty()) {
+		FILE* file = fopen(job.filename.c_str(), "wb");
+		if (!file) {
+			printf("ERROR: Could not write %s\n", job.filename.c_str());
+			return;
+		}
+		fprintf(file, "P6\n%d %d\n255\n", job.width, job.height);
+		fwrite(rgb.data(), 1, rgb.size(), file);
+		fclose(file);
+		return;
+	}
+
+	// a raw stream can't change size midway, start a new one when the window does
+	if (writer.stream && (job.width != writer.streamWidth || job.height != writer.streamHeight)) {
+		fclose(writer.stream);
+		writer.stream = nullptr;
+	}
+	if (!writer.stream) {
+		char name[64];
+		snprintf(name, sizeof(name), "/capture_%dx%d_%d.rgb", job.width, job.height, writer.numStreams++);
+		std::string path = writer.dir + name;
+		writer.stream = fopen(path.c_str(), "wb");
+		if (!writer.stream) {
+			printf("ERROR: Could not write %s\n", path.c_str());
+			return;
+		}
+		writer.streamWidth = job.width;
+		writer.streamHeight = job.height;
+		printf("Capturing to %s (ffmpeg -f rawvideo -pixel_format rgb24 -video_size %dx%d -i %s out.mp4)\n",
+			path.c_str(), job.width, job.height, path.c_str());
+	}
+	fwrite(rgb.data(), 1, rgb.size(), writer.stream);
+}
+
+static void writerLoop(FrameWriter& writer) {
+	std::vector<unsigned char> rgb;
+	while (true) {
+		WriterJob job;
+		{
+			std::unique_lock<std::mutex> lock(writer.mutex);
+			writer.jobReady.wait(lock, [&] { return writer.stopping || !writer.jobs.empty(); });
+			if (writer.jobs.empty()) break; // stopping and nothing left to write
+			job = std::move(writer.jobs.front());
+			writer.jobs.pop_front();
+		}
+		auto start = std::chrono::steady_clock::now();
+		writeJob(writer, job, rgb);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		std::lock_guard<std::mutex> lock(writer.mutex);
+		writer.written++;
+		writer.writeMs += ms;
+		if ((int)writer.freeBuffers.size() < MAX_FREE_BUFFERS) {
+			writer.freeBuffers.push_back(std::move(job.pixels));
+		}
+	}
+	if (writer.stream) {
+		fclose(writer.stream);
+		writer.stream = nullptr;
+	}
+}
+
+void startFrameWriter(FrameWriter& writer, const std::string& dir) {
+	writer.dir = dir;
+	writer.stopping = false;
+	writer.thread = std::thread(writerLoop, std::ref(writer));
+}
+
+bool submitFrame(FrameWriter& writer, std::vector<uint32_t>& pixels, int width, int height, bool bottomUp, const std::string& filename) {
+	{
+		std::lock_guard<std::mutex> lock(writer.mutex);
+		if ((int)writer.jobs.size() >= MAX_QUEUED_FRAMES) {
+			writer.dropped++;
+			return false;
+		}
+		writer.jobs.emplace_back();
+		WriterJob& job = writer.jobs.back();
+		job.pixels.swap(pixels);
+		job.width = width;
+		job.height = height;
+		job.bottomUp = bottomUp;
+		job.filename = filename;
+	}
+	writer.jobReady.notify_one();
+	return true;
+}
+
+void takeFrameBuffer(FrameWriter& writer, std::vector<uint32_t>& pixels, size_t count) {
+	if (pixels.size() == count) return;
+	{
+		std::lock_guard<std::mutex> lock(writer.mutex);
+		if (!writer.freeBuffers.empty()) {
+			pixels.swap(writer.freeBuffers.back());
+			writer.freeBuffers.pop_back();
+		}
+	}
+	// only allocates when nothing came back or the frame size changed
+	pixels.resize(count);
+}
+
+void stopFrameWriter(FrameWriter& writer) {
+	if (!writer.thread.joinable()) return;
+	{
+		std::lock_guard<std::mutex> lock(writer.mutex);
+		writer.stopping = true;
+	}
+	writer.jobReady.notify_one();
+	writer.thread.join();
+}
+
+std::string frameFileName(const FrameWriter& writer, const char* prefix, int index) {
+	char name[64];
+	snprintf(name, sizeof(name), "/%s_%04d.ppm", prefix, index);
+	return writer.dir + name;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// BACKGROUND FRAME WRITER
+// captured frames are handed to a thread of their own, which turns them into PPM files or
+// appends them to one raw video stream, so the frame that captured them never waits on the
+// disk. the game feeds it from PBO readbacks, the headless runner from the raycaster.
+// pixels are 32 bit 0xAARRGGBB (SDL_PIXELFORMAT_ARGB8888, or GL_BGRA read back as
+// GL_UNSIGNED_INT_8_8_8_8_REV), the writer converts to RGB itself. buffers of written frames
+// go on a small free list, so a steady capture doesn't allocate a new frame every time
+
+// frames waiting beyond this are dropped instead of piling up in memory
+const int MAX_QUEUED_FRAMES = 8;
+// written frames' buffers kept for takeFrameBuffer()
+const int MAX_FREE_BUFFERS = 4;
+
+enum FrameFormat {
+	FRAME_PPM,  // one binary PPM per frame
+	FRAME_RAW   // RGB24 frames back to back in capture_<W>x<H>_<N>.rgb, for ffmpeg -f rawvideo
+};
+
+struct WriterJob {
+	std::vector<uint32_t> pixels;
+	int width = 0;
+	int height = 0;
+	bool bottomUp = false;  // rows as glReadPixels returns them
+	std::string filename;   // empty appends to the raw stream
+};
+
+struct FrameWriter {
+	std::string dir;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable jobReady;
+	std::deque<WriterJob> jobs;
+	std::vector<std::vector<uint32_t>> freeBuffers; // under mutex
+	bool stopping = false;
+
+	// raw stream, only touched by the writer thread
+	FILE* stream = nullptr;
+	int streamWidth = 0;
+	int streamHeight = 0;
+	int numStreams = 0;
+
+	// stats, under mutex
+	int written = 0;
+	int dropped = 0;
+	double writeMs = 0; // converting and writing, on the writer thread
+};
+
+void startFrameWriter(FrameWriter& writer, const std::string& dir);
+// queue a frame, pixels are swapped out of the caller's vector, which is left empty. false if
+// the queue was full and the frame got dropped, pixels are kept then
+bool submitFrame(FrameWriter& writer, std::vector<uint32_t>& pixels, int width, int height, bool bottomUp, const std::string& filename);
+// make pixels hold count pixels for the next frame, reusing a written frame's buffer when
+// pixels doesn't have the size already. contents are left over from an older frame
+void takeFrameBuffer(FrameWriter& writer, std::vector<uint32_t>& pixels, size_t count);
+// write everything still queued, then stop the thread
+void stopFrameWriter(FrameWriter& writer);
+// PPM name for frame number index in the writer's directory, e.g. <dir>/screenshot_0003.ppm
+std::string frameFileName(const FrameWriter& writer, const char* prefix, int index);
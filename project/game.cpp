@@ -12,233 +12,985 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <vector>
+#include <cstring>
 #include <algorithm>
+#include <random>
+
+#include "file_watcher.h"
+#include "sim.h"
+#include "thread_pool.h"
+#include "clusters.h"
+#include "ao_bake.h"
+#include "minimap.h"
+#include "dynamic_res.h"
+#include "stream_ring.h"
+#include "raycast.h"
+#include "frame_writer.h"
 
-// struct for keys
-struct Key {
-	int x;
-	int y;
-	char id;
-	bool picked = false;
+int screenWidth = 800;
+int screenHeight = 600;
+float timePast = 0;
+
+bool DEBUG_ON = true;
+GLuint InitShader(const char* vShaderFileName, const char* fShaderFileName, bool exitOnError = true);
+bool fullscreen = false;
+bool Win2PPM(int width, int height);
+float rand01() {
+	return rand() / (float)RAND_MAX;
+}
+
+// STATIC MAP GEOMETRY
+// floor tiles and walls never move, so instead of one draw call per tile they are
+// baked into world space vertex buffers, one per CHUNK_SIZE x CHUNK_SIZE block of tiles.
+// when the grid changes (hot reload) only the chunks holding changed tiles are rebuilt
+const int CHUNK_SIZE = 8;
+// chunk vertices are the 8 model floats plus the baked ambient occlusion
+const int CHUNK_VERTEX_FLOATS = 9;
+
+struct MapChunk {
+	int row0 = 0; // first grid row covered by this chunk
+	int col0 = 0; // first grid column covered by this chunk
+	GLuint vao = 0;
+	GLuint vbo = 0;
+	int numFloorVerts = 0; // floor vertices come first in the vbo, walls after them
+	int numWallVerts = 0;
+	bool dirty = true;
 };
 
-struct Door {
-	int x;
-	int y;
-	char id;
-	char key_id;
-	bool unlocked = false;
+struct MapMesh {
+	int chunksX = 0;
+	int chunksY = 0;
+	std::vector<MapChunk> chunks;
+	// cube model the tiles are built from (8 floats per vertex, same layout as modelData)
+	const float* cubeVerts = nullptr;
+	int numCubeVerts = 0;
+	GLuint program = 0;
+	const AOBake* ao = nullptr;
+};
+
+// point the attributes of the currently bound vao at the currently bound vbo
+// (position, texcoord, normal interleaved as 8 floats, same as the model files).
+// withAO is for the chunk buffers, which carry a 9th float of baked occlusion
+void setupVertexAttribs(GLuint program, bool withAO) {
+	int stride = (withAO ? CHUNK_VERTEX_FLOATS : 8) * sizeof(float);
+	GLint posAttrib = glGetAttribLocation(program, "position");
+	glVertexAttribPointer(posAttrib, 3, GL_FLOAT, GL_FALSE, stride, 0);
+	glEnableVertexAttribArray(posAttrib);
+
+	GLint normAttrib = glGetAttribLocation(program, "inNormal");
+	glVertexAttribPointer(normAttrib, 3, GL_FLOAT, GL_FALSE, stride, (void*)(5 * sizeof(float)));
+	glEnableVertexAttribArray(normAttrib);
+
+	GLint texAttrib = glGetAttribLocation(program, "inTexcoord");
+	glEnableVertexAttribArray(texAttrib);
+	glVertexAttribPointer(texAttrib, 2, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+
+	GLint aoAttrib = glGetAttribLocation(program, "inAO");
+	if (aoAttrib < 0) return;
+	if (withAO) {
+		glVertexAttribPointer(aoAttrib, 1, GL_FLOAT, GL_FALSE, stride, (void*)(8 * sizeof(float)));
+		glEnableVertexAttribArray(aoAttrib);
+	}
+	else {
+		// models aren't baked, they read the constant attribute value instead
+		glDisableVertexAttribArray(aoAttrib);
+		glVertexAttrib1f(aoAttrib, 1.0f);
+	}
+}
+
+// append a copy of the cube scaled then moved to offset. the cube is axis aligned so
+// scaling along the axes leaves the normals pointing the same way.
+// floor vertices take the occlusion of the tile corner they sit on. walls are only darkened
+// at their base, and only by the tiles in front of each face, so they fade up from the seam
+// with the floor where something actually boxes them in
+void appendCube(std::vector<float>& out, const MapMesh& mesh, glm::vec3 offset, glm::vec3 scale, bool isWall) {
+	for (int v = 0; v < mesh.numCubeVerts; v++) {
+		const float* in = mesh.cubeVerts + v * 8;
+		float x = in[0] * scale.x + offset.x;
+		float y = in[1] * scale.y + offset.y;
+		out.push_back(x);
+		out.push_back(y);
+		out.push_back(in[2] * scale.z + offset.z);
+		for (int i = 3; i < 8; i++) {
+			out.push_back(in[i]);
+		}
+		if (!isWall) {
+			out.push_back(cornerAO(*mesh.ao, x, y));
+		}
+		else if (in[2] > 0.0f || fabsf(in[7]) > 0.5f) {
+			out.push_back(1.0f); // top edge, or the top and bottom faces
+		}
+		else {
+			out.push_back(wallBaseAO(*mesh.ao, x, y, in[5], in[6]));
+		}
+	}
+}
+
+void buildChunk(MapChunk& chunk, const MapMesh& mesh, const Map& map) {
+	int rowEnd = std::min(chunk.row0 + CHUNK_SIZE, map.height);
+	int colEnd = std::min(chunk.col0 + CHUNK_SIZE, map.width);
+
+	std::vector<float> floorVerts;
+	std::vector<float> wallVerts;
+	for (int row = chunk.row0; row < rowEnd; row++) {
+		int flippedRow = map.height - 1 - row;
+		for (int col = chunk.col0; col < colEnd; col++) {
+			// same placement the per tile draw calls used
+			appendCube(floorVerts, mesh, glm::vec3(col + 0.5f, flippedRow + 0.5f, -0.45f - 0.1f / 2.0f), glm::vec3(1.0f, 1.0f, 0.1f), false);
+			if (map.grid[row][col] == 'W') {
+				appendCube(wallVerts, mesh, glm::vec3(col + 0.5f, flippedRow + 0.5f, 0.0f), glm::vec3(1.0f), true);
+			}
+		}
+	}
+	chunk.numFloorVerts = (int)floorVerts.size() / CHUNK_VERTEX_FLOATS;
+	chunk.numWallVerts = (int)wallVerts.size() / CHUNK_VERTEX_FLOATS;
+	floorVerts.insert(floorVerts.end(), wallVerts.begin(), wallVerts.end());
+
+	if (chunk.vao == 0) {
+		glGenVertexArrays(1, &chunk.vao);
+		glGenBuffers(1, &chunk.vbo);
+		glBindVertexArray(chunk.vao);
+		glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
+		setupVertexAttribs(mesh.program, true);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
+	glBufferData(GL_ARRAY_BUFFER, floorVerts.size() * sizeof(float), floorVerts.data(), GL_STATIC_DRAW);
+	glBindVertexArray(0);
+	chunk.dirty = false;
+}
+
+void freeMapMesh(MapMesh& mesh) {
+	for (auto& chunk : mesh.chunks) {
+		glDeleteBuffers(1, &chunk.vbo);
+		glDeleteVertexArrays(1, &chunk.vao);
+	}
+	mesh.chunks.clear();
+	mesh.chunksX = 0;
+	mesh.chunksY = 0;
+}
+
+void markCellDirty(MapMesh& mesh, int row, int col) {
+	mesh.chunks[(row / CHUNK_SIZE) * mesh.chunksX + col / CHUNK_SIZE].dirty = true;
+}
+
+// a tile's occlusion changed: its corners are shared with the 8 tiles around it, so any
+// of their chunks may need the new values
+void markAODirty(MapMesh& mesh, const Map& map, int row, int col) {
+	for (int r = std::max(row - 1, 0); r <= std::min(row + 1, map.height - 1); r++) {
+		for (int c = std::max(col - 1, 0); c <= std::min(col + 1, map.width - 1); c++) {
+			markCellDirty(mesh, r, c);
+		}
+	}
+}
+
+// returns how many chunks were rebuilt
+int rebuildDirtyChunks(MapMesh& mesh, const Map& map) {
+	int rebuilt = 0;
+	for (auto& chunk : mesh.chunks) {
+		if (chunk.dirty) {
+			buildChunk(chunk, mesh, map);
+			rebuilt++;
+		}
+	}
+	return rebuilt;
+}
+
+// (re)create every chunk for the map, used at startup and when the map size changes
+void initMapMesh(MapMesh& mesh, const Map& map) {
+	freeMapMesh(mesh);
+	mesh.chunksX = (map.width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	mesh.chunksY = (map.height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	mesh.chunks.resize(mesh.chunksX * mesh.chunksY);
+	for (int cy = 0; cy < mesh.chunksY; cy++) {
+		for (int cx = 0; cx < mesh.chunksX; cx++) {
+			MapChunk& chunk = mesh.chunks[cy * mesh.chunksX + cx];
+			chunk.row0 = cy * CHUNK_SIZE;
+			chunk.col0 = cx * CHUNK_SIZE;
+		}
+	}
+	rebuildDirtyChunks(mesh, map);
+}
+
+// after a shader reload the attribute locations may have moved
+void setMapMeshProgram(MapMesh& mesh, GLuint program) {
+	mesh.program = program;
+	for (auto& chunk : mesh.chunks) {
+		glBindVertexArray(chunk.vao);
+		glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
+		setupVertexAttribs(program, true);
+	}
+	glBindVertexArray(0);
+}
 
+// DRAW SUBMISSION
+// per draw data (model matrix, color, texture) is either streamed through a ring buffer and
+// read by instanced draws (clustered-Vertex.glsl), or set with the old glUniform calls per
+// draw (uniform-Vertex.glsl, the shader from before the ring). both paths submit the same
+// batches, so the stats line can compare what the cpu spends on each.
+// matches DrawRecord in clustered-Vertex.glsl, std140 lays it out as a mat4 then a vec4
+struct DrawRecord {
+	glm::mat4 model;
+	glm::vec4 colorTex; // rgb color, texture id in w (-1 = plain color)
 };
-// struct for storing map information
-struct Map {
-	int width;
-	int height;
-	std::vector<std::string> grid; 
-	// coordinates for start position and goal position
-	int startX = -1;
-	int startY = -1;
-	int goalX = -1;
-	int goalY = -1;
-	// for creating a grid in C++ https://stackoverflow.com/questions/61766469/create-grid-in-c
-
-	std::vector<Key> keys;
-	std::vector<Door> doors;
+static_assert(sizeof(DrawRecord) == 80, "DrawRecord must match the std140 layout");
+
+const int MAX_DRAWS_PER_BATCH = 128; // MAX_DRAWS in clustered-Vertex.glsl
+const GLuint FRAME_DATA_BINDING = 0;
+const GLuint DRAW_DATA_BINDING = 1;
+const size_t DRAW_BLOCK_BYTES = MAX_DRAWS_PER_BATCH * sizeof(DrawRecord);
+
+// one mesh drawn any number of times
+struct DrawBatch {
+	int startVert = 0;
+	int numVerts = 0;
+	std::vector<DrawRecord> records;
+	size_t ringOffset = 0; // where the records went in the stream ring this frame
 };
 
+struct DrawSubmit {
+	bool streamed = true;
+	bool canStream = true;  // false once the ring failed, the uniform path always works
+	StreamRing ring;
+	GLint uniModel = -1; // old path
+	GLint uniTexID = -1;
+	GLint uniColor = -1;
+};
 
+DrawRecord makeDrawRecord(const glm::mat4& model, glm::vec3 color, int texID) {
+	return { model, glm::vec4(color, (float)texID) };
+}
 
-int screenWidth = 800;
-int screenHeight = 600;
-float timePast = 0;
-const float PLAYER_RADIUS = 0.35f;
+bool initDrawSubmit(DrawSubmit& submit) {
+	// 4 KB covers the frame data and a couple of batches, the ring grows if a map needs more
+	if (!initStreamRing(submit.ring, GL_UNIFORM_BUFFER, 4096, DRAW_BLOCK_BYTES)) {
+		return false;
+	}
+	// batches over MAX_DRAWS_PER_BATCH are bound a block at a time, those offsets have to
+	// land on the alignment too
+	if (DRAW_BLOCK_BYTES % submit.ring.alignment != 0) {
+		printf("ERROR: Uniform buffer alignment %zu doesn't divide the draw block, using per draw uniforms\n", submit.ring.alignment);
+		submit.streamed = submit.canStream = false;
+	}
+	return true;
+}
 
-bool DEBUG_ON = true;
-GLuint InitShader(const char* vShaderFileName, const char* fShaderFileName);
-bool fullscreen = false;
-void Win2PPM(int width, int height);
-float rand01() {
-	return rand() / (float)RAND_MAX;
+// uniform blocks get their binding points after every link
+void bindShaderBlocks(GLuint program) {
+	GLuint frameBlock = glGetUniformBlockIndex(program, "FrameData");
+	if (frameBlock != GL_INVALID_INDEX) glUniformBlockBinding(program, frameBlock, FRAME_DATA_BINDING);
+	GLuint drawBlock = glGetUniformBlockIndex(program, "DrawData");
+	if (drawBlock != GL_INVALID_INDEX) glUniformBlockBinding(program, drawBlock, DRAW_DATA_BINDING);
 }
 
-bool loadMap(const std::string filename, Map& map) {
-	// referenced https://cplusplus.com/reference/vector/vector/ for functions in vector library
-	FILE* file = fopen(filename.c_str(), "r");
-	// open file
-	if (!file) {
-		printf("ERROR: Could not open %s\n", filename.c_str());
+// point the model vao and every map chunk at program's attribute locations, after switching
+// between the streamed and uniform programs or reloading them
+void useDrawProgram(GLuint program, GLuint modelVao, GLuint modelVbo, MapMesh& mesh) {
+	glBindVertexArray(modelVao);
+	glBindBuffer(GL_ARRAY_BUFFER, modelVbo);
+	setupVertexAttribs(program, false);
+	setMapMeshProgram(mesh, program);
+}
+
+void setDrawSubmitProgram(DrawSubmit& submit, GLuint program) {
+	submit.uniModel = glGetUniformLocation(program, "model");
+	submit.uniTexID = glGetUniformLocation(program, "texID");
+	submit.uniColor = glGetUniformLocation(program, "inColor");
+}
+
+// write view, proj and every batch's records into this frame's ring slot in one map
+bool streamFrameData(DrawSubmit& submit, const glm::mat4& view, const glm::mat4& proj, const std::vector<DrawBatch*>& batches) {
+	glm::mat4 frameData[2] = { view, proj };
+	size_t bytes = streamAlignedSize(submit.ring, sizeof(frameData));
+	for (DrawBatch* batch : batches) {
+		bytes += streamAlignedSize(submit.ring, batch->records.size() * sizeof(DrawRecord));
+	}
+	if (!beginStreamFrame(submit.ring, bytes)) {
 		return false;
 	}
+	size_t frameOffset = streamWrite(submit.ring, frameData, sizeof(frameData));
+	for (DrawBatch* batch : batches) {
+		batch->ringOffset = streamWrite(submit.ring, batch->records.data(), batch->records.size() * sizeof(DrawRecord));
+	}
+	endStreamWrites(submit.ring);
+	glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, submit.ring.buffer, frameOffset, sizeof(frameData));
+	return true;
+}
+
+// make records[first] (and the ones after it, when streamed) the current draw data
+static void useDrawRecords(const DrawSubmit& submit, const DrawBatch& batch, size_t first) {
+	if (submit.streamed) {
+		glBindBufferRange(GL_UNIFORM_BUFFER, DRAW_DATA_BINDING, submit.ring.buffer,
+			batch.ringOffset + first * sizeof(DrawRecord), DRAW_BLOCK_BYTES);
+		return;
+	}
+	const DrawRecord& record = batch.records[first];
+	glUniformMatrix4fv(submit.uniModel, 1, GL_FALSE, glm::value_ptr(record.model));
+	glUniform3fv(submit.uniColor, 1, glm::value_ptr(record.colorTex));
+	glUniform1i(submit.uniTexID, (int)record.colorTex.w);
+}
+
+// returns the number of draw calls issued
+int drawBatch(const DrawSubmit& submit, const DrawBatch& batch) {
+	int draws = 0;
+	if (submit.streamed) {
+		for (size_t first = 0; first < batch.records.size(); first += MAX_DRAWS_PER_BATCH) {
+			useDrawRecords(submit, batch, first);
+			int count = (int)std::min(batch.records.size() - first, (size_t)MAX_DRAWS_PER_BATCH);
+			glDrawArraysInstanced(GL_TRIANGLES, batch.startVert, batch.numVerts, count);
+			draws++;
+		}
+		return draws;
+	}
+	for (size_t i = 0; i < batch.records.size(); i++) {
+		useDrawRecords(submit, batch, i);
+		glDrawArrays(GL_TRIANGLES, batch.startVert, batch.numVerts);
+		draws++;
+	}
+	return draws;
+}
+
+// floors and walls hold one record each, chunk vertices are already in world space.
+// returns the number of draw calls issued
+int drawMapMesh(const MapMesh& mesh, const DrawSubmit& submit, const DrawBatch& floors, const DrawBatch& walls) {
+	int draws = 0;
+	useDrawRecords(submit, floors, 0);
+	for (auto& chunk : mesh.chunks) {
+		glBindVertexArray(chunk.vao);
+		glDrawArrays(GL_TRIANGLES, 0, chunk.numFloorVerts);
+		draws++;
+	}
+	useDrawRecords(submit, walls, 0);
+	for (auto& chunk : mesh.chunks) {
+		if (chunk.numWallVerts > 0) {
+			glBindVertexArray(chunk.vao);
+			glDrawArrays(GL_TRIANGLES, chunk.numFloorVerts, chunk.numWallVerts);
+			draws++;
+		}
+	}
+	return draws;
+}
+
+void freeDrawSubmit(DrawSubmit& submit) {
+	freeStreamRing(submit.ring);
+}
+
+// CLUSTERED LIGHTING (GPU side)
+// the cluster lists built by assignLights() go to the fragment shader as buffer textures
+struct ClusterBuffers {
+	GLuint lightBuf = 0; // 2 RGBA32F texels per light: view space position + radius, color + intensity
+	GLuint lightTex = 0;
+	GLuint gridBuf = 0;  // RG32UI per cluster: offset into the index list, light count
+	GLuint gridTex = 0;
+	GLuint indexBuf = 0; // R32UI light indices
+	GLuint indexTex = 0;
+};
+
+static void initBufferTexture(GLuint& buffer, GLuint& texture, GLenum format) {
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_BUFFER, texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+}
+
+void initClusterBuffers(ClusterBuffers& buffers) {
+	initBufferTexture(buffers.lightBuf, buffers.lightTex, GL_RGBA32F);
+	initBufferTexture(buffers.gridBuf, buffers.gridTex, GL_RG32UI);
+	initBufferTexture(buffers.indexBuf, buffers.indexTex, GL_R32UI);
+}
 
-	// read line for width and height of the map
-	if (fscanf(file, "%d %d\n", &map.width, &map.height) != 2) {
-		printf("ERROR: Could not read map dimensions");
-		fclose(file);
+// re-specify the whole buffer every frame, the driver hands back fresh memory instead of
+// waiting for last frame's draws to finish reading the old contents
+static void streamBuffer(GLuint buffer, const void* data, size_t bytes) {
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, std::max(bytes, (size_t)16), NULL, GL_STREAM_DRAW);
+	if (bytes > 0) {
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+	}
+}
+
+void uploadClusterBuffers(const ClusterBuffers& buffers, const ClusterGrid& grid, const std::vector<PointLight>& viewLights) {
+	streamBuffer(buffers.lightBuf, viewLights.data(), viewLights.size() * sizeof(PointLight));
+	streamBuffer(buffers.gridBuf, grid.offsetCount.data(), grid.offsetCount.size() * sizeof(unsigned int));
+	streamBuffer(buffers.indexBuf, grid.lightIndices.data(), grid.lightIndices.size() * sizeof(unsigned int));
+}
+
+// buffer textures go on units 2-4, after the wood and brick textures
+void bindClusterBuffers(const ClusterBuffers& buffers, const ClusterGrid& grid, GLuint program) {
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_BUFFER, buffers.lightTex);
+	glUniform1i(glGetUniformLocation(program, "lightData"), 2);
+	glActiveTexture(GL_TEXTURE3);
+	glBindTexture(GL_TEXTURE_BUFFER, buffers.gridTex);
+	glUniform1i(glGetUniformLocation(program, "clusterGrid"), 3);
+	glActiveTexture(GL_TEXTURE4);
+	glBindTexture(GL_TEXTURE_BUFFER, buffers.indexTex);
+	glUniform1i(glGetUniformLocation(program, "lightIndices"), 4);
+
+	glUniform3i(glGetUniformLocation(program, "clusterDims"), CLUSTER_X, CLUSTER_Y, CLUSTER_Z);
+	glUniform1f(glGetUniformLocation(program, "clusterNear"), grid.nearPlane);
+	glUniform1f(glGetUniformLocation(program, "clusterSliceScale"), clusterSliceScale(grid));
+}
+
+void freeClusterBuffers(ClusterBuffers& buffers) {
+	GLuint bufs[3] = { buffers.lightBuf, buffers.gridBuf, buffers.indexBuf };
+	GLuint texs[3] = { buffers.lightTex, buffers.gridTex, buffers.indexTex };
+	glDeleteBuffers(3, bufs);
+	glDeleteTextures(3, texs);
+}
+
+// SCENE RENDER TARGET
+// the 3D scene is drawn into the bottom left corner of an offscreen buffer sized for the
+// whole window, then stretched over the window. changing the resolution scale only changes
+// how much of the buffer gets used, so nothing is reallocated unless the window resizes
+struct SceneTarget {
+	GLuint fbo = 0;
+	GLuint colorTex = 0;
+	GLuint depthRb = 0;
+	int width = 0;  // allocated size, the window size
+	int height = 0;
+};
+
+bool resizeSceneTarget(SceneTarget& target, int width, int height) {
+	if (target.fbo != 0 && target.width == width && target.height == height) {
+		return true;
+	}
+	if (target.fbo == 0) {
+		glGenFramebuffers(1, &target.fbo);
+		glGenTextures(1, &target.colorTex);
+		glGenRenderbuffers(1, &target.depthRb);
+	}
+	target.width = width;
+	target.height = height;
+
+	glBindTexture(GL_TEXTURE_2D, target.colorTex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindRenderbuffer(GL_RENDERBUFFER, target.depthRb);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.colorTex, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.depthRb);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		printf("ERROR: Scene framebuffer incomplete (0x%x)\n", status);
 		return false;
 	}
-	
-	printf("Map dimensions: %d x %d\n", map.width, map.height);
-	// clear vector of possible previous data, and reserve space for the grid
-	map.grid.clear();
-	map.grid.reserve(map.height);
-
-	char buffer[1024];
-	for (int i = 0; i < map.height; i++) {
-		if (!fgets(buffer, sizeof(buffer), file)) {
-			printf("ERROR: Failed to read row\n");
-			fclose(file);
-			return false;
-		}
-
-		buffer[strcspn(buffer, "\r\n")] = 0;
-
-		if (strlen(buffer) != map.width) {
-			printf("ERROR: Row has wrong length\n");
-			fclose(file);
-			return false;
-		}
-
-		std::string row = buffer;
-		map.grid.push_back(row);
-		for (int col = 0; col < row.size(); col++) {
-			char ch = row[col];
-			if (ch >= 'a' && ch <= 'e') {
-				Key key;
-				key.x = col;
-				key.y = i;
-				key.id = ch;     
-				map.keys.push_back(key);
-			}
+	return true;
+}
 
-			if (ch >= 'A' && ch <= 'E') {
-				Door door;
-				door.x = col;
-				door.y = i;
-				door.id = ch;
-				door.key_id = std::tolower(ch); // https://www.geeksforgeeks.org/cpp/tolower-function-in-cpp/
-				map.doors.push_back(door);
-			}
-			if (ch == 'S') {
-				map.startX = col;
-				map.startY = i;
-			}
+// stretch the renderWidth x renderHeight corner over the window. linear filtering in the
+// blit is the whole upscaler, it costs next to nothing even on the software renderer
+void presentSceneTarget(const SceneTarget& target, int renderWidth, int renderHeight) {
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, target.fbo);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	GLenum filter = (renderWidth == target.width && renderHeight == target.height) ? GL_NEAREST : GL_LINEAR;
+	glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, target.width, target.height, GL_COLOR_BUFFER_BIT, filter);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, target.width, target.height);
+}
 
-			if (ch == 'G') {
-				map.goalX = col;
-				map.goalY = i;
-			}
-		}	
-		printf("%s\n", buffer);
+void freeSceneTarget(SceneTarget& target) {
+	glDeleteFramebuffers(1, &target.fbo);
+	glDeleteTextures(1, &target.colorTex);
+	glDeleteRenderbuffers(1, &target.depthRb);
+	target.fbo = target.colorTex = target.depthRb = 0;
+}
+
+// FRAME TIMING
+// the resolution controller needs what a frame costs without making the cpu wait for the
+// gpu, a glFinish every frame would stop the two from overlapping. the cpu side is timed
+// directly, the gpu side with GL_TIME_ELAPSED queries that are only read once they are done,
+// a couple of frames later. a frame costs whichever side is slower. without timer queries
+// (ARB_timer_query, core in 3.3), or while the gpu is too far behind for them to come back,
+// it falls back to the wall time between swaps
+const int FRAME_TIMER_QUERIES = 3;
+
+struct FrameTimer {
+	GLuint queries[FRAME_TIMER_QUERIES] = {};
+	bool pending[FRAME_TIMER_QUERIES] = {};
+	int next = 0;
+	bool supported = false;
+	bool behind = false; // this frame's query slot was still running
+	bool firstResult = true; // llvmpipe returns a timestamp instead of a duration for it
+	float gpuMs = 0;     // latest finished query
+	Uint64 lastSwap = 0;
+};
+
+void initFrameTimer(FrameTimer& timer) {
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	bool core33 = major > 3 || (major == 3 && minor >= 3);
+	timer.supported = glGetQueryObjectui64v != NULL && (core33 || SDL_GL_ExtensionSupported("GL_ARB_timer_query"));
+	if (timer.supported) {
+		glGenQueries(FRAME_TIMER_QUERIES, timer.queries);
+	}
+	else {
+		printf("No GPU timer queries, timing frames from swap to swap\n");
+	}
+	timer.lastSwap = SDL_GetPerformanceCounter();
+}
+
+void beginFrameTimer(FrameTimer& timer) {
+	if (!timer.supported) return;
+	// oldest first, so gpuMs ends up with the newest finished frame. never waits
+	for (int i = 0; i < FRAME_TIMER_QUERIES; i++) {
+		int slot = (timer.next + i) % FRAME_TIMER_QUERIES;
+		if (!timer.pending[slot]) continue;
+		GLuint available = 0;
+		glGetQueryObjectuiv(timer.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) break;
+		GLuint64 ns = 0;
+		glGetQueryObjectui64v(timer.queries[slot], GL_QUERY_RESULT, &ns);
+		if (!timer.firstResult) {
+			timer.gpuMs = (float)(ns / 1000000.0);
+		}
+		timer.firstResult = false;
+		timer.pending[slot] = false;
+	}
+	// a query still running after FRAME_TIMER_QUERIES frames is just overwritten
+	timer.behind = timer.pending[timer.next];
+	glBeginQuery(GL_TIME_ELAPSED, timer.queries[timer.next]);
+}
+
+void endFrameTimer(FrameTimer& timer) {
+	if (!timer.supported) return;
+	glEndQuery(GL_TIME_ELAPSED);
+	timer.pending[timer.next] = true;
+	timer.next = (timer.next + 1) % FRAME_TIMER_QUERIES;
+}
+
+// right after the swap. cpuMs is the frame's own work up to the swap
+float frameCost(FrameTimer& timer, float cpuMs) {
+	Uint64 now = SDL_GetPerformanceCounter();
+	float wallMs = (float)((now - timer.lastSwap) * 1000.0 / SDL_GetPerformanceFrequency());
+	timer.lastSwap = now;
+	if (!timer.supported || timer.behind) return wallMs;
+	return std::max(cpuMs, timer.gpuMs);
+}
+
+void freeFrameTimer(FrameTimer& timer) {
+	if (timer.supported) {
+		glDeleteQueries(FRAME_TIMER_QUERIES, timer.queries);
 	}
-	printf("Number of keys: %d\n", map.keys.size());
-	printf("Number of doors: %d\n", map.doors.size());
-	fclose(file);
+}
+
+// FRAME CAPTURE
+// glReadPixels into a pixel buffer object returns right away, the copy happens on the gpu
+// in its own time. the buffer is only mapped a frame or two later, once its fence says the
+// copy is done, and the pixels go straight to the background writer (frame_writer.h).
+// if every buffer is still busy a continuous capture frame is skipped rather than waited
+// on, and a screenshot is tried again on the next frame
+const int CAPTURE_PBOS = 3;
+
+struct FrameCapture {
+	GLuint pbos[CAPTURE_PBOS] = {};
+	GLsync fences[CAPTURE_PBOS] = {};
+	int width[CAPTURE_PBOS] = {};
+	int height[CAPTURE_PBOS] = {};
+	size_t bytes[CAPTURE_PBOS] = {};
+	std::string filename[CAPTURE_PBOS]; // empty goes to the raw stream
+	int next = 0;                       // oldest buffer, the one to read into next
+	FrameWriter writer;
+	std::vector<uint32_t> pixels;       // the next frame for the writer, recycled through it
+
+	bool continuous = false;
+	FrameFormat format = FRAME_PPM;
+	int screenshots = 0;
+	int captures = 0;
+	// render thread cost since the last report
+	int readbacks = 0;
+	int busy = 0;         // readbacks put off because every buffer was still in flight
+	double renderMs = 0;
+	double copyMs = 0;    // part of renderMs, copying finished readbacks out of the pbos
+};
+
+FrameCapture frameCapture;
+
+void initFrameCapture(FrameCapture& capture, const std::string& dir) {
+	glGenBuffers(CAPTURE_PBOS, capture.pbos);
+	startFrameWriter(capture.writer, dir);
+}
+
+// hand every finished readback to the writer, oldest first. wait blocks on them instead,
+// for shutdown
+static void collectReadbacks(FrameCapture& capture, bool wait) {
+	for (int i = 0; i < CAPTURE_PBOS; i++) {
+		int slot = (capture.next + i) % CAPTURE_PBOS;
+		GLsync& fence = capture.fences[slot];
+		if (!fence) continue;
+		GLenum result = glClientWaitSync(fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000 : 0);
+		if (result == GL_TIMEOUT_EXPIRED) break; // later ones can't be done either
+		glDeleteSync(fence);
+		fence = 0;
+		if (result == GL_WAIT_FAILED) {
+			printf("ERROR: Capture fence wait failed, dropping %s\n",
+				capture.filename[slot].empty() ? "a stream frame" : capture.filename[slot].c_str());
+			continue;
+		}
+
+		// the one copy the render thread still makes per frame: a memcpy out of the mapped pbo
+		// into a buffer the writer handed back, so the pbo is free again right away
+		Uint64 copyStart = SDL_GetPerformanceCounter();
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, capture.pbos[slot]);
+		const uint32_t* mapped = (const uint32_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, capture.bytes[slot], GL_MAP_READ_BIT);
+		if (mapped) {
+			takeFrameBuffer(capture.writer, capture.pixels, (size_t)capture.width[slot] * capture.height[slot]);
+			memcpy(capture.pixels.data(), mapped, capture.pixels.size() * sizeof(uint32_t));
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			submitFrame(capture.writer, capture.pixels, capture.width[slot], capture.height[slot], true, capture.filename[slot]);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		capture.copyMs += (SDL_GetPerformanceCounter() - copyStart) * 1000.0 / SDL_GetPerformanceFrequency();
+	}
+}
+
+// start reading the back buffer into the next free pbo. the file is named prefix_NNNN.ppm
+// from counter, which only counts up when the readback really starts, no prefix appends to
+// the raw stream. false if every pbo was busy
+static bool startReadback(FrameCapture& capture, int width, int height, const char* prefix, int* counter) {
+	int slot = capture.next;
+	if (capture.fences[slot]) {
+		capture.busy++;
+		return false;
+	}
+	size_t bytes = (size_t)width * height * 4;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, capture.pbos[slot]);
+	if (capture.bytes[slot] != bytes) {
+		glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+		capture.bytes[slot] = bytes;
+	}
+	// BGRA as 8_8_8_8_REV is 0xAARRGGBB per pixel, what the writer expects, and the format
+	// drivers can copy without converting
+	glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	capture.fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	capture.width[slot] = width;
+	capture.height[slot] = height;
+	capture.filename[slot] = prefix ? frameFileName(capture.writer, prefix, (*counter)++) : "";
+	capture.next = (slot + 1) % CAPTURE_PBOS;
+	capture.readbacks++;
 	return true;
+}
+
+// once a frame, after the last draw into the window and before the swap
+void updateFrameCapture(FrameCapture& capture, int width, int height) {
+	Uint64 start = SDL_GetPerformanceCounter();
+	// collect first, so a readback that just finished frees its buffer for this frame
+	collectReadbacks(capture, false);
+	if (capture.continuous) {
+		bool raw = capture.format == FRAME_RAW;
+		startReadback(capture, width, height, raw ? NULL : "capture", &capture.captures);
+	}
+	capture.renderMs += (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+}
 
+// what capturing cost since the last call, then start counting again
+void reportFrameCapture(FrameCapture& capture, int frames) {
+	int written, dropped;
+	double writeMs;
+	{
+		std::lock_guard<std::mutex> lock(capture.writer.mutex);
+		written = capture.writer.written;
+		dropped = capture.writer.dropped;
+		writeMs = capture.writer.writeMs;
+	}
+	printf("      capture %.3f ms/frame on the render thread (%.3f copying out of pbos), %d readbacks (%d skipped, pbos busy), %d written so far at %.2f ms each in the background, %d dropped\n",
+		capture.renderMs / std::max(frames, 1), capture.copyMs / std::max(frames, 1), capture.readbacks, capture.busy, written, written > 0 ? writeMs / written : 0.0, dropped);
+	capture.renderMs = 0;
+	capture.copyMs = 0;
+	capture.readbacks = 0;
+	capture.busy = 0;
 }
 
+void freeFrameCapture(FrameCapture& capture) {
+	collectReadbacks(capture, true);
+	stopFrameWriter(capture.writer);
+	for (int i = 0; i < CAPTURE_PBOS; i++) {
+		if (capture.fences[i]) glDeleteSync(capture.fences[i]);
+		capture.fences[i] = 0;
+	}
+	glDeleteBuffers(CAPTURE_PBOS, capture.pbos);
+}
 
-// huge help from this article
-// https://learnopengl.com/In-Practice/2D-Game/Collisions/Collision-detection
-bool wallCollision(float px, float py, Map& map) {
-	//printf("Coordinate of check : %f %f\n", px, py);
-	int rowMin = (int)floor(py - PLAYER_RADIUS);
-	int rowMax = (int)floor(py + PLAYER_RADIUS);
-	int colMin = (int)floor(px + PLAYER_RADIUS);
-	int colMax = (int)floor(px + PLAYER_RADIUS);
+// screenshot of the window as <capture dir>/screenshot_NNNN.ppm. only queues the readback,
+// the file shows up a frame or two later. false if every pbo was busy, call again next frame
+bool Win2PPM(int width, int height) {
+	Uint64 start = SDL_GetPerformanceCounter();
+	bool started = startReadback(frameCapture, width, height, "screenshot", &frameCapture.screenshots);
+	frameCapture.renderMs += (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+	return started;
+}
 
-	for (int r = rowMin; r <= rowMax; ++r) {
-		for (int c = colMin; c <= colMax; ++c) {
-	/*for (int r = 0; r < map.width; ++r) {
-		for (int c = 0; c < map.height; ++c) {*/
-			int mapRow = map.height - 1 - r;
-			int mapCol = c;
+// every key still lying on the floor, the goal and every unlocked door glows
+void gatherMapLights(const Map& map, const GameState& state, std::vector<PointLight>& lights) {
+	for (size_t k = 0; k < map.keys.size(); k++) {
+		if (state.keyPicked[k]) continue;
+		const Key& key = map.keys[k];
+		lights.push_back({ key.x + 0.5f, map.height - 1 - key.y + 0.5f, 0.1f, 2.0f, 1.0f, 0.8f, 0.3f, 1.5f });
+	}
+	for (size_t d = 0; d < map.doors.size(); d++) {
+		if (!state.doorUnlocked[d]) continue;
+		const Door& door = map.doors[d];
+		lights.push_back({ door.x + 0.5f, map.height - 1 - door.y + 0.5f, 0.1f, 2.0f, 0.3f, 0.6f, 1.0f, 1.5f });
+	}
+	if (map.goalX >= 0) {
+		lights.push_back({ map.goalX + 0.5f, map.height - 1 - map.goalY + 0.5f, 0.1f, 3.0f, 0.4f, 1.0f, 0.5f, 2.0f });
+	}
+}
 
-			// treat out of bounds like collision
-			if (mapRow < 0 || mapRow >= map.height || mapCol < 0 || mapCol >= map.width) {
-				//printf("Out of bounds\n");
-				return true;
-			}
-			
+// scatter count lights over the open tiles for the --bench-lights sweep
+// same lights every run, from a generator of its own so the game's rand() is left alone
+void makeBenchLights(const Map& map, int count, std::vector<PointLight>& lights) {
+	lights.clear();
+	std::mt19937 rng(5607);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	while ((int)lights.size() < count) {
+		int row = (int)(rng() % map.height);
+		int col = (int)(rng() % map.width);
+		if (map.grid[row][col] == 'W') continue;
+		lights.push_back({ col + unit(rng), map.height - 1 - row + unit(rng), unit(rng) * 0.4f - 0.2f, 1.5f, unit(rng), unit(rng), unit(rng), 1.0f });
+	}
+}
+
+// the camera of a --bench-raycast frame: turn on the spot once over the measured frames,
+// so every frame sees different walls. both renderers get the same views
+float benchRaycastYaw(const GameState& state, int frame, int frames) {
+	return state.yaw + frame * 360.0f / frames;
+}
+
+// the raycaster half of --bench-raycast, at the GL path's render size on the same thread
+// pool. returns ms per measured frame, the render only (nothing is shown or uploaded)
+double benchRaycastMs(const Map& map, const GameState& state, int width, int height, int warmupFrames, int frames, ThreadPool& pool) {
+	RayTexture wallTexture, doorTexture;
+	loadRayTexture("brick.bmp", wallTexture);
+	loadRayTexture("wood.bmp", doorTexture);
+	RaycastFrame frame;
+	resizeRaycastFrame(frame, width, height);
+	Uint64 start = 0;
+	for (int f = 0; f < warmupFrames + frames; f++) {
+		if (f == warmupFrames) start = SDL_GetPerformanceCounter();
+		RaycastView view;
+		view.x = state.x;
+		view.y = state.y;
+		view.yaw = benchRaycastYaw(state, f - warmupFrames, frames);
+		view.time = f / 60.0f;
+		renderRaycast(frame, map, state, wallTexture, doorTexture, view, pool);
+	}
+	return (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency() / frames;
+}
+
+// HOT RELOAD
+// re-parse a changed scene file and swap it in for the running map. player, key and door
+// state is kept wherever the new layout allows it, and only the chunks containing tiles
+// that differ from the current grid are rebuilt, so the cost follows the size of the edit
+bool reloadMap(const std::string& filename, Map& map, MapMesh& mesh, GameState& state, AOBake& ao, ThreadPool& pool) {
+	Uint64 startCount = SDL_GetPerformanceCounter();
 
-			// WALL TILE CHECK
-			if (map.grid[mapRow][mapCol] == 'W') {
-
-				// cube bounding box
-				float cubeXMin = (float)c;
-				float cubeXMax = (float)c + 1.0f;
-				float cubeYMin = (float)r;
-				float cubeYMax = (float)r + 1.0f;
-				//printf("cubeXMin: %f cubeXMax: %f\n", cubeXMin, cubeXMax);
-				//printf("cubeYMin: %f cubeYMax: %f\n", cubeYMin, cubeYMax);
-
-				// player bounding box
-				float pxMin = px + PLAYER_RADIUS;
-				float pxMax = px - PLAYER_RADIUS;
-				float pyMin = py + PLAYER_RADIUS;
-				float pyMax = py - PLAYER_RADIUS;
-				//printf("px: %f\n", px);
-				//printf("py: %f\n", py);
-
-				if (pxMin > cubeXMin && pxMax < cubeXMax &&
-					pyMin > cubeYMin && pyMax < cubeYMax) {
-					printf("Collision detected\n");
-					return true;
+	Map next;
+	if (!loadMap(filename, next)) {
+		printf("ERROR: Keeping the current map, %s failed to load\n", filename.c_str());
+		return false;
+	}
+
+	std::vector<int> changedTiles;
+	bool sameSize = next.width == map.width && next.height == map.height;
+	if (sameSize) {
+		for (int row = 0; row < map.height; row++) {
+			if (next.grid[row] == map.grid[row]) continue;
+			for (int col = 0; col < map.width; col++) {
+				if (next.grid[row][col] != map.grid[row][col]) {
+					changedTiles.push_back(row * map.width + col);
 				}
 			}
+		}
+	}
 
-			// KEY TILE CHECK
-			if (map.grid[mapRow][mapCol] >= 'a' && map.grid[mapRow][mapCol] <= 'e') {
-				for (auto& key : map.keys) {
-					if (key.id == map.grid[mapRow][mapCol]) {
-						if (!key.picked) {
-							key.picked = true;
-							printf("Key %c has been picked up\n", key.id);
-							return false;
-						}
-						else {
-							float keyXMin = (float)c;
-							float keyXMax = (float)c + 0.3f;
-							float keyYMin = (float)r;
-							float keyYMax = (float)r + 0.3f;
-
-							// player bounding box
-							float pxMin = px + PLAYER_RADIUS;
-							float pxMax = px - PLAYER_RADIUS;
-							float pyMin = py + PLAYER_RADIUS;
-							float pyMax = py - PLAYER_RADIUS;
-
-							if (pxMin > keyXMin && pxMax < keyXMax &&
-								pyMin > keyYMin && pyMax < keyYMax) {
-								printf("Key detected\n");
-								return false;
-							}
-						}
-					}
-				}
-					return false;
+	GameState nextState;
+	carryOverGame(map, state, next, nextState);
+	map = std::move(next);
+	state = std::move(nextState);
+
+	int rebuiltChunks;
+	if (sameSize) {
+		// only the occlusion around changed tiles can be different
+		for (int tile : changedTiles) {
+			rebakeTileAO(ao, map, state, tile / map.width, tile % map.width);
+			markAODirty(mesh, map, tile / map.width, tile % map.width);
+		}
+		ao.bakedDoorUnlocked = state.doorUnlocked;
+		rebuiltChunks = rebuildDirtyChunks(mesh, map);
+	}
+	else {
+		bakeAO(ao, map, state, pool);
+		initMapMesh(mesh, map);
+		rebuiltChunks = (int)mesh.chunks.size();
+	}
+	int numChanged = sameSize ? (int)changedTiles.size() : map.width * map.height;
+
+	float ms = (SDL_GetPerformanceCounter() - startCount) * 1000.0f / SDL_GetPerformanceFrequency();
+	printf("Reloaded %s in %.2f ms: %d tiles changed, %d chunks rebuilt\n", filename.c_str(), ms, numChanged, rebuiltChunks);
+	return true;
+}
+
+// movement keys, the same in both renderers
+Action keyToAction(SDL_Keycode key) {
+	switch (key) {
+		// move fowards
+		case SDLK_UP:
+		case SDLK_W:
+			return ACTION_FORWARD;
+		// move backwards
+		case SDLK_DOWN:
+		case SDLK_S:
+			return ACTION_BACKWARD;
+		// rotate camera left and right
+		case SDLK_RIGHT:
+		case SDLK_D:
+			return ACTION_TURN_RIGHT;
+		case SDLK_LEFT:
+		case SDLK_A:
+			return ACTION_TURN_LEFT;
+	}
+	return ACTION_NONE;
+}
+
+// SOFTWARE RENDERER
+// --software: no GL context at all. each frame is raycast on the thread pool (raycast.h)
+// and shown through a streaming SDL texture on SDL's software renderer, which stretches it
+// over the window. dynamic resolution and the stats line work the same as in the GL path
+int runSoftwareRenderer(SDL_Window* window, const std::string& mapFileName, Map& map, GameState& state, ThreadPool& pool, DynamicRes& dynamicRes) {
+	SDL_Renderer* renderer = SDL_CreateRenderer(window, "software");
+	if (!renderer) {
+		printf("ERROR: Could not create the software renderer: %s\n", SDL_GetError());
+		return 1;
+	}
+	RayTexture wallTexture, doorTexture;
+	if (!loadRayTexture("brick.bmp", wallTexture) || !loadRayTexture("wood.bmp", doorTexture)) {
+		printf("Drawing flat colors for missing textures\n");
+	}
+
+	FileWatcher watcher;
+	initFileWatcher(watcher);
+	watchFile(watcher, mapFileName);
+
+	RaycastFrame frame;
+	SDL_Texture* screen = NULL;
+	bool screenshotRequested = false;
+	Uint64 statsStart = SDL_GetPerformanceCounter();
+	int statsFrames = 0;
+	double statsMs = 0;
+	SDL_Event windowEvent;
+	bool quit = false;
+	while (!quit) {
+		Uint64 frameStart = SDL_GetPerformanceCounter();
+
+		// scene hot reload, there are no meshes to rebuild here
+		if (!pollFileWatcher(watcher, SDL_GetTicks()).empty()) {
+			Map next;
+			if (loadMap(mapFileName, next)) {
+				GameState nextState;
+				carryOverGame(map, state, next, nextState);
+				map = next;
+				state = nextState;
+				printf("Reloaded %s\n", mapFileName.c_str());
 			}
+		}
 
-			// DOOR TILE CHECK
-			if (map.grid[mapRow][mapCol] >= 'A' && map.grid[mapRow][mapCol] <= 'E') {
-				for (auto& door : map.doors) {
-					if (door.id == map.grid[mapRow][mapCol]) {
-						for (auto& key : map.keys) {
-							if (key.id == door.key_id && key.picked) {
-								door.unlocked = true;
-								printf("Door has been unlocked!\n");
-								return false;
-							}
-						}
-					}
+		while (SDL_PollEvent(&windowEvent)) {
+			if (windowEvent.type == SDL_EVENT_QUIT) quit = true;
+			if (windowEvent.type == SDL_EVENT_KEY_UP && (windowEvent.key.key == SDLK_ESCAPE || windowEvent.key.key == SDLK_Q))
+				quit = true;
+			if (windowEvent.type == SDL_EVENT_KEY_UP && windowEvent.key.key == SDLK_F) {
+				fullscreen = !fullscreen;
+				SDL_SetWindowFullscreen(window, fullscreen);
+			}
+			if (windowEvent.type == SDL_EVENT_KEY_UP && windowEvent.key.key == SDLK_R) {
+				setDynamicResEnabled(dynamicRes, !dynamicRes.enabled);
+				printf("Dynamic resolution %s\n", dynamicRes.enabled ? "on" : "off, scale locked at 1.00");
+			}
+			if (windowEvent.type == SDL_EVENT_KEY_UP && windowEvent.key.key == SDLK_P)
+				screenshotRequested = true;
+			if (windowEvent.type == SDL_EVENT_KEY_UP && windowEvent.key.key == SDLK_V) {
+				frameCapture.continuous = !frameCapture.continuous;
+				printf("Continuous capture %s\n", frameCapture.continuous ? "on" : "off");
+			}
+			if (windowEvent.type == SDL_EVENT_KEY_DOWN) {
+				if (stepGame(map, state, keyToAction(windowEvent.key.key)) && state.reachedGoal) {
+					SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_INFORMATION, "Goal reached!", "You've reached your goal!", window);
+					quit = true;
 				}
-				printf("Need key to open door\n");
-				return true;
 			}
 		}
+
+		SDL_GetWindowSizeInPixels(window, &screenWidth, &screenHeight);
+		int renderWidth, renderHeight;
+		dynamicResSize(dynamicRes, screenWidth, screenHeight, renderWidth, renderHeight);
+		if (renderWidth != frame.width || renderHeight != frame.height) {
+			resizeRaycastFrame(frame, renderWidth, renderHeight);
+			SDL_DestroyTexture(screen);
+			screen = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, renderWidth, renderHeight);
+			SDL_SetTextureScaleMode(screen, SDL_SCALEMODE_LINEAR);
+		}
+
+		// same camera the GL path builds its view matrix from
+		RaycastView view;
+		view.x = state.x;
+		view.y = state.y;
+		view.yaw = state.yaw;
+		view.time = SDL_GetTicks() / 1000.f;
+		renderRaycast(frame, map, state, wallTexture, doorTexture, view, pool);
+		SDL_UpdateTexture(screen, NULL, frame.pixels.data(), frame.width * sizeof(uint32_t));
+		SDL_RenderTexture(renderer, screen, NULL, NULL);
+
+		// captures are at the render resolution, the pixels are already in memory
+		Uint64 captureStart = SDL_GetPerformanceCounter();
+		if (screenshotRequested || frameCapture.continuous) {
+			std::string filename = screenshotRequested ? frameFileName(frameCapture.writer, "screenshot", frameCapture.screenshots++)
+				: frameCapture.format == FRAME_PPM ? frameFileName(frameCapture.writer, "capture", frameCapture.captures++) : "";
+			// handed over without a copy, the next frame is raycast into a recycled buffer
+			submitFrame(frameCapture.writer, frame.pixels, frame.width, frame.height, false, filename);
+			takeFrameBuffer(frameCapture.writer, frame.pixels, (size_t)frame.width * frame.height);
+			frameCapture.readbacks++;
+			screenshotRequested = false;
+		}
+		frameCapture.renderMs += (SDL_GetPerformanceCounter() - captureStart) * 1000.0 / SDL_GetPerformanceFrequency();
+
+		float frameMs = (float)((SDL_GetPerformanceCounter() - frameStart) * 1000.0 / SDL_GetPerformanceFrequency());
+		float oldScale = dynamicRes.scale;
+		DynamicResDecision decision = updateDynamicRes(dynamicRes, frameMs);
+		if (decision != DYNAMIC_RES_HOLD) {
+			printf("Resolution scale %.2f -> %.2f: average %.2f ms %s target %.2f ms\n", oldScale, dynamicRes.scale,
+				dynamicRes.lastAverageMs, decision == DYNAMIC_RES_DOWN ? "over" : "well under", dynamicRes.targetMs);
+		}
+		SDL_RenderPresent(renderer);
+
+		statsFrames++;
+		statsMs += frameMs;
+		double statsSeconds = (SDL_GetPerformanceCounter() - statsStart) / (double)SDL_GetPerformanceFrequency();
+		if (DEBUG_ON && statsSeconds >= 1.0) {
+			printf("%5.1f fps  %6.2f ms/frame (target %.2f)  scale %.2f %s  %dx%d -> %dx%d  software raycast, %d threads\n",
+				statsFrames / statsSeconds, statsMs / statsFrames, dynamicRes.targetMs, dynamicRes.scale,
+				dynamicRes.enabled ? "auto" : "fixed", renderWidth, renderHeight, screenWidth, screenHeight, (int)pool.workers.size());
+			if (frameCapture.continuous || frameCapture.readbacks > 0) {
+				reportFrameCapture(frameCapture, statsFrames);
+			}
+			statsStart = SDL_GetPerformanceCounter();
+			statsFrames = 0;
+			statsMs = 0;
+		}
 	}
-	printf("No collision\n");
-	return false;
+
+	closeFileWatcher(watcher);
+	SDL_DestroyTexture(screen);
+	SDL_DestroyRenderer(renderer);
+	return 0;
 }
 
 int main(int argc, char* argv[]) {
@@ -246,6 +998,37 @@ int main(int argc, char* argv[]) {
 		printf("Need map file\n");
 		return 1;
 	}
+	SIM_LOG = true;
+	// --bench-lights renders a fixed view (movement keys are ignored) with 1, 2, 4 ... 1024
+	// extra point lights and prints the frame time of each step, then quits
+	// --bench-raycast turns on the spot with OpenGL, then raycasts the same views at the same
+	// size, and prints ms/frame for both, then quits
+	// --target-ms N sets the frame time dynamic resolution aims for (default 60 fps),
+	// --fixed-res turns it off
+	// --uniform-draws starts on the old per draw uniform path (U switches while running)
+	// --software renders with the raycaster instead of OpenGL
+	// --capture records every frame (V toggles it, P takes one screenshot) into --capture-dir,
+	// as PPMs or one raw video stream with --capture-format raw
+	bool benchLights = false;
+	bool benchRaycaster = false;
+	bool captureFromStart = false;
+	std::string captureDir = ".";
+	bool uniformDraws = false;
+	bool software = false;
+	DynamicRes dynamicRes;
+	for (int i = 2; i < argc; i++) {
+		if (strcmp(argv[i], "--bench-lights") == 0) benchLights = true;
+		else if (strcmp(argv[i], "--bench-raycast") == 0) benchRaycaster = true;
+		else if (strcmp(argv[i], "--uniform-draws") == 0) uniformDraws = true;
+		else if (strcmp(argv[i], "--software") == 0) software = true;
+		else if (strcmp(argv[i], "--capture") == 0) captureFromStart = true;
+		else if (strcmp(argv[i], "--capture-dir") == 0 && i + 1 < argc) captureDir = argv[++i];
+		else if (strcmp(argv[i], "--capture-format") == 0 && i + 1 < argc) {
+			frameCapture.format = strcmp(argv[++i], "raw") == 0 ? FRAME_RAW : FRAME_PPM;
+		}
+		else if (strcmp(argv[i], "--fixed-res") == 0) setDynamicResEnabled(dynamicRes, false);
+		else if (strcmp(argv[i], "--target-ms") == 0 && i + 1 < argc) dynamicRes.targetMs = (float)atof(argv[++i]);
+	}
 
 	SDL_Init(SDL_INIT_VIDEO);
 
@@ -254,6 +1037,30 @@ int main(int argc, char* argv[]) {
 	printf("\nCompiled against SDL version %d.%d.%d ...\n", SDL_VERSIONNUM_MAJOR(SDL_VERSION), SDL_VERSIONNUM_MINOR(SDL_VERSION), SDL_VERSIONNUM_MICRO(SDL_VERSION));
 	printf("Linking against SDL version %d.%d.%d.\n", SDL_VERSIONNUM_MAJOR(sdl_linked), SDL_VERSIONNUM_MINOR(sdl_linked), SDL_VERSIONNUM_MICRO(sdl_linked));
 
+	if (software) {
+		SDL_Window* window = SDL_CreateWindow("My Software Renderer", screenWidth, screenHeight, 0);
+		if (!window) {
+			printf("SDL_CreateWindow Error: %s\n", SDL_GetError());
+			SDL_Quit();
+			return 1;
+		}
+		Map map;
+		if (!loadMap(argv[1], map)) return -1;
+		GameState state;
+		resetGame(map, state);
+		ThreadPool pool;
+		startThreadPool(pool, 0);
+		// no pbos here, frames go straight from the raycaster to the writer
+		startFrameWriter(frameCapture.writer, captureDir);
+		frameCapture.continuous = captureFromStart;
+		int result = runSoftwareRenderer(window, argv[1], map, state, pool, dynamicRes);
+		stopFrameWriter(frameCapture.writer);
+		stopThreadPool(pool);
+		SDL_DestroyWindow(window);
+		SDL_Quit();
+		return result;
+	}
+
 	//Ask SDL to get a recent version of OpenGL (3.2 or greater)
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
@@ -413,24 +1220,17 @@ int main(int argc, char* argv[]) {
 	//GL_STATIC_DRAW means we won't change the geometry, GL_DYNAMIC_DRAW = geometry changes infrequently
 	//GL_STREAM_DRAW = geom. changes frequently.  This effects which types of GPU memory is used
 
-	int texturedShader = InitShader("textured-Vertex.glsl", "textured-Fragment.glsl");
+	const char* vertexShaderFile = "clustered-Vertex.glsl";
+	const char* uniformVertexShaderFile = "uniform-Vertex.glsl";
+	const char* fragmentShaderFile = "clustered-Fragment.glsl";
+	GLuint streamedShader = InitShader(vertexShaderFile, fragmentShaderFile);
+	bindShaderBlocks(streamedShader);
+	// the per draw uniform path keeps the old vertex shader as a program of its own
+	GLuint uniformShader = InitShader(uniformVertexShaderFile, fragmentShaderFile);
+	GLuint texturedShader = streamedShader; // whichever of the two the frame draws with
 
 	//Tell OpenGL how to set fragment shader input 
-	GLint posAttrib = glGetAttribLocation(texturedShader, "position");
-	glVertexAttribPointer(posAttrib, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), 0);
-	//Attribute, vals/attrib., type, isNormalized, stride, offset
-	glEnableVertexAttribArray(posAttrib);
-
-	GLint normAttrib = glGetAttribLocation(texturedShader, "inNormal");
-	glVertexAttribPointer(normAttrib, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(5 * sizeof(float)));
-	glEnableVertexAttribArray(normAttrib);
-
-	GLint texAttrib = glGetAttribLocation(texturedShader, "inTexcoord");
-	glEnableVertexAttribArray(texAttrib);
-	glVertexAttribPointer(texAttrib, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-
-	GLint uniView = glGetUniformLocation(texturedShader, "view");
-	GLint uniProj = glGetUniformLocation(texturedShader, "proj");
+	setupVertexAttribs(texturedShader, false);
 
 	glBindVertexArray(0); //Unbind the VAO in case we want to create a new one	
 
@@ -442,29 +1242,167 @@ int main(int argc, char* argv[]) {
 	std::string mapFileName = argv[1];
 	if (!loadMap(mapFileName, map)) return -1;
 
+	// the player lives in the GameState, the camera just follows it around
+	GameState state;
+	resetGame(map, state);
+
+	// flat 2d shader for the minimap and other overlays
+	const char* screenVertexFile = "screen-Vertex.glsl";
+	const char* screenFragmentFile = "screen-Fragment.glsl";
+	GLuint screenShader = InitShader(screenVertexFile, screenFragmentFile);
+
+	Minimap minimap;
+	if (!initMinimap(minimap, map, screenShader)) return -1;
+
+	DrawSubmit drawSubmit;
+	if (!initDrawSubmit(drawSubmit)) return -1;
+	if (uniformDraws) drawSubmit.streamed = false;
+
+	// worker threads for map load and per frame jobs like assigning lights to clusters.
+	// anything that can fail at startup goes above this, a running pool can't be left behind
+	ThreadPool pool;
+	startThreadPool(pool, 0);
+
+	AOBake aoBake;
+	bakeAO(aoBake, map, state, pool);
+
+	MapMesh mapMesh;
+	mapMesh.cubeVerts = modelData + startVertCube * 8;
+	mapMesh.numCubeVerts = numVertsCube;
+	mapMesh.program = texturedShader;
+	mapMesh.ao = &aoBake;
+	initMapMesh(mapMesh, map);
+
+	// watch the scene and shaders so edits show up without restarting
+	FileWatcher watcher;
+	initFileWatcher(watcher);
+	watchFile(watcher, mapFileName);
+	watchFile(watcher, vertexShaderFile);
+	watchFile(watcher, uniformVertexShaderFile);
+	watchFile(watcher, fragmentShaderFile);
+	watchFile(watcher, screenVertexFile);
+	watchFile(watcher, screenFragmentFile);
+
+	ClusterGrid clusterGrid;
+	ClusterBuffers clusterBuffers;
+	initClusterBuffers(clusterBuffers);
+	std::vector<PointLight> lights;
+	std::vector<PointLight> benchLightList;
+
+	const int BENCH_WARMUP_FRAMES = 10;
+	const int BENCH_FRAMES = 100;
+	const int BENCH_MAX_LIGHTS = 1024;
+	int benchLightCount = 1;
+	int benchFrame = 0;
+	double benchFrameMs = 0;
+	double benchAssignMs = 0;
+	int benchMaxLights = 0;
+	if (benchLights) {
+		SDL_GL_SetSwapInterval(0); // don't let vsync hide the cost
+		setDynamicResEnabled(dynamicRes, false); // and compare every step at full resolution
+		// max/cluster is the longest light list any cluster got, nothing is dropped
+		printf("\n%8s %12s %12s %12s\n", "lights", "frame ms", "assign ms", "max/cluster");
+	}
+	if (benchRaycaster) {
+		SDL_GL_SetSwapInterval(0);
+		setDynamicResEnabled(dynamicRes, false);
+	}
+
+	SceneTarget sceneTarget;
+	FrameTimer frameTimer;
+	initFrameTimer(frameTimer);
+
+	initFrameCapture(frameCapture, captureDir);
+	frameCapture.continuous = captureFromStart;
+	bool screenshotRequested = false;
+	DrawBatch floorBatch, wallBatch, doorBatch, keyBatch, goalBatch;
+	floorBatch.records.push_back(makeDrawRecord(glm::mat4(1.0f), glm::vec3(0, 0, 0), -1)); // floors are plain black
+	wallBatch.records.push_back(makeDrawRecord(glm::mat4(1.0f), glm::vec3(0, 0, 0), 1));   // walls use the brick texture
+	doorBatch.startVert = startVertKnot;
+	doorBatch.numVerts = numVertsKnot;
+	keyBatch.startVert = startVertTeapot;
+	keyBatch.numVerts = numVertsTeapot;
+	goalBatch.startVert = startVertSphere;
+	goalBatch.numVerts = numVertsSphere;
+	std::vector<DrawBatch*> drawBatches = { &floorBatch, &wallBatch, &doorBatch, &keyBatch, &goalBatch };
+	// frame statistics, printed once a second when DEBUG_ON
+	Uint64 statsStart = SDL_GetPerformanceCounter();
+	int statsFrames = 0;
+	double statsMs = 0;
+	double statsCpuMs = 0;
+	double statsGpuMs = 0;
+	double statsSubmitMs = 0;
+
 	SDL_Event windowEvent;
 	bool quit = false;
+	int exitCode = 0;
 
 	// FIRST PERSON POV
-	int startRow = map.height - 1 - map.startY;
-	int startCol = map.startX;
 	float eyeHeight = 0.2f;
-	glm::vec3 eye(startCol + 0.5f, startRow + 0.5f, eyeHeight);
+	glm::vec3 eye(state.x, state.y, eyeHeight);
 
 	glm::vec3 forward(0.0f, 1.0f, 0.0f);
 	glm::vec3 center = eye + forward;
 	glm::vec3 up(0.0f, 0.0f, 1.0f);
-	float camMove = 0.05f;
 
 	// VARIABLES FOR CAMERA
-	float yaw = 90.0f;
+	float yaw = state.yaw;
 	glm::vec3 right = glm::normalize(glm::cross(forward, up));
 
-	glm::vec3 flatForward(cos(glm::radians(yaw)), sin(glm::radians(yaw)), 0.0f);
-	flatForward = glm::normalize(flatForward);
-	glm::vec3 attempt;
-
 	while (!quit) {
+		Uint64 frameStart = SDL_GetPerformanceCounter();
+		beginFrameTimer(frameTimer);
+
+		// HOT RELOAD
+		bool shadersChanged = false;
+		bool screenShadersChanged = false;
+		for (auto& path : pollFileWatcher(watcher, SDL_GetTicks())) {
+			if (path == mapFileName) {
+				if (reloadMap(mapFileName, map, mapMesh, state, aoBake, pool)) {
+					reloadMinimap(minimap, map, screenShader);
+				}
+			}
+			else if (path == screenVertexFile || path == screenFragmentFile) {
+				screenShadersChanged = true;
+			}
+			else {
+				shadersChanged = true;
+			}
+		}
+		if (shadersChanged) {
+			// recompile both programs in place, they share the fragment shader. on a compile
+			// error the old programs keep running until the file is fixed
+			GLuint streamedProgram = InitShader(vertexShaderFile, fragmentShaderFile, false);
+			GLuint uniformProgram = InitShader(uniformVertexShaderFile, fragmentShaderFile, false);
+			if (streamedProgram == 0 || uniformProgram == 0) {
+				printf("ERROR: Shader reload failed, keeping the previous programs\n");
+				glDeleteProgram(streamedProgram);
+				glDeleteProgram(uniformProgram);
+			}
+			else {
+				glDeleteProgram(streamedShader);
+				glDeleteProgram(uniformShader);
+				streamedShader = streamedProgram;
+				uniformShader = uniformProgram;
+				bindShaderBlocks(streamedShader);
+				texturedShader = drawSubmit.streamed ? streamedShader : uniformShader;
+				useDrawProgram(texturedShader, vao, vbo[0], mapMesh);
+				printf("Reloaded shaders %s, %s and %s\n", vertexShaderFile, uniformVertexShaderFile, fragmentShaderFile);
+			}
+		}
+		if (screenShadersChanged) {
+			GLuint program = InitShader(screenVertexFile, screenFragmentFile, false);
+			if (program == 0) {
+				printf("ERROR: Shader reload failed, keeping the previous program\n");
+			}
+			else {
+				glDeleteProgram(screenShader);
+				screenShader = program;
+				setMinimapProgram(minimap, screenShader);
+				printf("Reloaded shaders %s and %s\n", screenVertexFile, screenFragmentFile);
+			}
+		}
+
 		while (SDL_PollEvent(&windowEvent)) {  //inspect all events in the queue
 			if (windowEvent.type == SDL_EVENT_QUIT) quit = true;
 			if (windowEvent.type == SDL_EVENT_KEY_UP && windowEvent.key.key == SDLK_ESCAPE)
@@ -473,72 +1411,54 @@ int main(int argc, char* argv[]) {
 				fullscreen = !fullscreen;
 				SDL_SetWindowFullscreen(window, fullscreen ? SDL_WINDOW_FULLSCREEN : 0); //Toggle fullscreen 
 			}
+			if (windowEvent.type == SDL_EVENT_KEY_UP && windowEvent.key.key == SDLK_M)
+				minimap.visible = !minimap.visible;
+			if (windowEvent.type == SDL_EVENT_KEY_UP && windowEvent.key.key == SDLK_R) {
+				setDynamicResEnabled(dynamicRes, !dynamicRes.enabled);
+				printf("Dynamic resolution %s\n", dynamicRes.enabled ? "on" : "off, scale locked at 1.00");
+			}
+			if (windowEvent.type == SDL_EVENT_KEY_UP && windowEvent.key.key == SDLK_P)
+				screenshotRequested = true;
+			if (windowEvent.type == SDL_EVENT_KEY_UP && windowEvent.key.key == SDLK_V) {
+				frameCapture.continuous = !frameCapture.continuous;
+				printf("Continuous capture %s\n", frameCapture.continuous ? "on" : "off");
+			}
+			if (windowEvent.type == SDL_EVENT_KEY_UP && windowEvent.key.key == SDLK_U) {
+				drawSubmit.streamed = !drawSubmit.streamed && drawSubmit.canStream;
+				printf("Per draw data: %s\n", drawSubmit.streamed ? "stream ring" : "uniforms");
+			}
 			if (windowEvent.type == SDL_EVENT_KEY_UP && windowEvent.key.key == SDLK_ESCAPE)
 				quit = true;
 			if (windowEvent.type == SDL_EVENT_KEY_UP && windowEvent.key.key == SDLK_Q)
 				quit = true;
 
 			
-			// help with keyboard / camera movement
-			// https://www.researchgate.net/figure/Definition-of-pitch-roll-and-yaw-angle-for-camera-state-estimation_fig15_273225757
-			if (windowEvent.type == SDL_EVENT_KEY_DOWN) {
-				glm::vec3 flatForward(cos(glm::radians(yaw)), sin(glm::radians(yaw)), 0.0f);
-				flatForward = glm::normalize(flatForward);
-
-				//glm::vec3 step(0.0f);
-				switch (windowEvent.key.key) {
-					// move fowards
-					case SDLK_UP:
-					case SDLK_W:
-						// have an attempted move and clamp the movement
-						attempt = eye + flatForward * camMove;
-						attempt.x = glm::clamp(attempt.x, PLAYER_RADIUS, (float)map.width - PLAYER_RADIUS);
-						attempt.y = glm::clamp(attempt.y, PLAYER_RADIUS, (float)map.height - PLAYER_RADIUS);
-						printf("Attempted move: x = %.3f, y = %.3f\n", attempt.x, attempt.y);
-						// if we didn't collide into anything, check if we are at the goal
-						if (!wallCollision(attempt.x, attempt.y, map)) {
-							eye = attempt;
-							float dx = eye.x - map.goalX;
-							float dy = eye.y - (map.height - 1 - map.goalY + 0.5f);
-							if (dx * dx + dy * dy <= 0.25f) {
-								SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_INFORMATION, "Goal reached!", "You've reached your goal!", window);
-								quit = true;
-							}
-						}
-						break;
-					// move backwards
-					case SDLK_DOWN:
-					case SDLK_S:
-						// have an attempted move and clamp the movement
-						attempt = eye - flatForward * camMove; 
-						attempt.x = glm::clamp(attempt.x, PLAYER_RADIUS, (float)map.width - PLAYER_RADIUS);
-						attempt.y = glm::clamp(attempt.y, PLAYER_RADIUS, (float)map.height - PLAYER_RADIUS);
-						printf("Attempted move: x = %.3f, y = %.3f\n", attempt.x, attempt.y);
-						// if we didn't collide into anything, check if we are at the goal
-						if (!wallCollision(attempt.x, attempt.y, map)) {
-							eye = attempt;
-							float dx = eye.x - map.goalX;
-							float dy = eye.y - (map.height - 1 - map.goalY + 0.5f);
-							if (dx * dx + dy * dy <= 0.25f) {
-								SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_INFORMATION, "Goal reached!", "You've reached your goal!", window);
-								quit = true;
-							}
-						}
-						break;
-					// rotate camera left and right
-					case SDLK_RIGHT:
-					case SDLK_D:
-						yaw -= 5.0f;
-						break;
-					case SDLK_LEFT:
-					case SDLK_A:
-						yaw += 5.0f;
-						break;
+			// the benchmarks keep the start view, every step has to render the same thing
+			if (windowEvent.type == SDL_EVENT_KEY_DOWN && !benchLights && !benchRaycaster) {
+				if (stepGame(map, state, keyToAction(windowEvent.key.key)) && state.reachedGoal) {
+					SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_INFORMATION, "Goal reached!", "You've reached your goal!", window);
+					quit = true;
 				}
 			}
 		}
 
+		// a door opened this frame, re-bake the occlusion around it
+		std::vector<int> aoTiles;
+		syncDoorAO(aoBake, map, state, aoTiles);
+		if (!aoTiles.empty()) {
+			for (int tile : aoTiles) {
+				markAODirty(mapMesh, map, tile / map.width, tile % map.width);
+			}
+			rebuildDirtyChunks(mapMesh, map);
+		}
+
 		// UPDATE GLOBAL CAMERA VECTORS
+		eye.x = state.x;
+		eye.y = state.y;
+		yaw = state.yaw;
+		if (benchRaycaster) {
+			yaw = benchRaycastYaw(state, benchFrame - BENCH_WARMUP_FRAMES, BENCH_FRAMES);
+		}
 		forward.x = cos(glm::radians(yaw));
 		forward.y = sin(glm::radians(yaw));
 		forward.z = 0.0f;
@@ -547,10 +1467,34 @@ int main(int argc, char* argv[]) {
 		right = glm::normalize(glm::cross(forward, up));
 		center = eye + forward;
 		
+		// DYNAMIC RESOLUTION
+		// fullscreen and resizes change the window, the scene buffer follows it
+		SDL_GetWindowSizeInPixels(window, &screenWidth, &screenHeight);
+		if (!resizeSceneTarget(sceneTarget, screenWidth, screenHeight)) {
+			exitCode = -1;
+			break;
+		}
+		int renderWidth, renderHeight;
+		dynamicResSize(dynamicRes, screenWidth, screenHeight, renderWidth, renderHeight);
+		glBindFramebuffer(GL_FRAMEBUFFER, sceneTarget.fbo);
+		glViewport(0, 0, renderWidth, renderHeight);
+
+		// the viewport doesn't limit glClear, the scissor keeps it to the part in use
+		glEnable(GL_SCISSOR_TEST);
+		glScissor(0, 0, renderWidth, renderHeight);
 		glClearColor(0.2f, 0.4f, 0.8f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glDisable(GL_SCISSOR_TEST);
 
+		// the U key (or a failed ring) may have changed the draw path since last frame
+		GLuint drawProgram = drawSubmit.streamed ? streamedShader : uniformShader;
+		if (drawProgram != texturedShader) {
+			texturedShader = drawProgram;
+			useDrawProgram(texturedShader, vao, vbo[0], mapMesh);
+		}
 		glUseProgram(texturedShader);
+		GLint uniView = glGetUniformLocation(texturedShader, "view");
+		GLint uniProj = glGetUniformLocation(texturedShader, "proj");
 
 		timePast = SDL_GetTicks() / 1000.f;
 
@@ -572,6 +1516,31 @@ int main(int argc, char* argv[]) {
 		glm::mat4 proj = glm::perspective(glm::radians(60.0f), screenWidth / (float)screenHeight, 0.1f, 100.0f);
 		glUniformMatrix4fv(uniProj, 1, GL_FALSE, glm::value_ptr(proj));
 
+		// CLUSTERED POINT LIGHTS
+		// same frustum as proj. lights are moved into view space here so the shader doesn't
+		// need a matrix per light
+		Uint64 assignStart = SDL_GetPerformanceCounter();
+		initClusterGrid(clusterGrid, glm::radians(60.0f), screenWidth / (float)screenHeight, 0.1f, 100.0f);
+		lights.clear();
+		gatherMapLights(map, state, lights);
+		if (benchLights) {
+			if ((int)benchLightList.size() != benchLightCount) {
+				makeBenchLights(map, benchLightCount, benchLightList);
+			}
+			lights.insert(lights.end(), benchLightList.begin(), benchLightList.end());
+		}
+		for (auto& light : lights) {
+			glm::vec4 viewPos = view * glm::vec4(light.x, light.y, light.z, 1.0f);
+			light.x = viewPos.x;
+			light.y = viewPos.y;
+			light.z = viewPos.z;
+		}
+		assignLights(clusterGrid, lights, pool);
+		double assignMs = (SDL_GetPerformanceCounter() - assignStart) * 1000.0 / SDL_GetPerformanceFrequency();
+		uploadClusterBuffers(clusterBuffers, clusterGrid, lights);
+		bindClusterBuffers(clusterBuffers, clusterGrid, texturedShader);
+		glUniform2f(glGetUniformLocation(texturedShader, "screenSize"), (float)renderWidth, (float)renderHeight);
+
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_2D, tex0);
 		glUniform1i(glGetUniformLocation(texturedShader, "tex0"), 0);
@@ -592,60 +1561,25 @@ int main(int argc, char* argv[]) {
 
 		glDrawArrays(GL_TRIANGLES, startVertCube, numVertsCube);*/
 
-		GLint uniModel = glGetUniformLocation(texturedShader, "model");
-		GLint uniTexID = glGetUniformLocation(texturedShader, "texID");
-		GLint uniColor = glGetUniformLocation(texturedShader, "inColor");
-		glm::vec3 colVec(0, 0, 0);
-		glUniform3fv(uniColor, 1, glm::value_ptr(colVec));
-
 		// DRAW GEOMETRIES ON MAP
+		// everything the frame draws is gathered into batches first, then submitted
+		doorBatch.records.clear();
+		keyBatch.records.clear();
+		goalBatch.records.clear();
 		for (int row = 0; row < map.height; row++) {
 			for (int col = 0; col < map.width; col++) {
-				// draw each floor tile while traversing through map grid
-				int flippedRow = map.height - 1 - row;
-				glm::mat4 floorModel = glm::mat4(1.0f);
-				floorModel = glm::translate(floorModel, glm::vec3(col + 0.5f, flippedRow + 0.5f, -0.45f - 0.1 / 2.0f));
-				floorModel = glm::scale(floorModel, glm::vec3(1.0f, 1.0f, 0.1f));
-				glUniformMatrix4fv(uniModel, 1, GL_FALSE, glm::value_ptr(floorModel));
-				glUniform1i(uniTexID, -1);
-				glm::vec3 colVec(0,0,0);
-				glUniform3fv(uniColor, 1, glm::value_ptr(colVec));
-				glDrawArrays(GL_TRIANGLES, startVertCube, numVertsCube);
-
 				char c = map.grid[row][col];
-				// WALL
-				if (c == 'W') {
-					int flippedRow = map.height - 1 - row;
-					/*glm::mat4 wallModel = glm::mat4(1.0f);
-					wallModel = glm::translate(wallModel, glm::vec3(col, flippedRow, 0));
-					wallModel = glm::scale(wallModel, glm::vec3(1.0f));*/
-
-					//DEBUG BOUNDING WALL CUBE BOX
-					glm::mat4 wallModel = glm::mat4(1.0f);
-					wallModel = glm::translate(wallModel, glm::vec3(col + 0.5f, flippedRow + 0.5f, 0.0f)); // center at middle of cell
-					wallModel = glm::scale(wallModel, glm::vec3(1.0f, 1.0f, 1.0f));
-				
-
-					glUniformMatrix4fv(uniModel, 1, GL_FALSE, glm::value_ptr(wallModel));
-					glUniform1i(uniTexID, 1);
-					glDrawArrays(GL_TRIANGLES, startVertCube, numVertsCube);
-				}
 
 				// DOOR
 				if (c >= 'A' && c <= 'E') {
 					int flippedRow = map.height - 1 - row;
-					glm::mat4 doorModel = glm::mat4(1.0f);
-					for (auto& door : map.doors) {
-						// if door is unlocked, do not render it
-						if (door.unlocked) {
+					for (size_t d = 0; d < map.doors.size(); d++) {
+						// only this tile's door, and not once it is unlocked
+						if (map.doors[d].x != col || map.doors[d].y != row || state.doorUnlocked[d]) {
 							continue;
 						}
-						else {
-							doorModel = glm::translate(doorModel, glm::vec3(col + 0.5f, flippedRow + 0.5f, 0));
-							glUniformMatrix4fv(uniModel, 1, GL_FALSE, glm::value_ptr(doorModel));
-							glUniform1i(uniTexID, 0);
-							glDrawArrays(GL_TRIANGLES, startVertKnot, numVertsKnot);
-						}
+						glm::mat4 doorModel = glm::translate(glm::mat4(1.0f), glm::vec3(col + 0.5f, flippedRow + 0.5f, 0));
+						doorBatch.records.push_back(makeDrawRecord(doorModel, glm::vec3(0, 0, 0), 0));
 					}
 				}
 
@@ -653,10 +1587,10 @@ int main(int argc, char* argv[]) {
 				if (c >= 'a' && c <= 'e') {
 					int flippedRow = map.height - 1 - row;
 					glm::mat4 keyModel = glm::mat4(1.0f);
-					for (auto& key : map.keys) {
-						if (key.id == c) {
+					for (size_t k = 0; k < map.keys.size(); k++) {
+						if (map.keys[k].id == c) {
 							// if key has been picked up, render it infront of us
-							if (key.picked) {
+							if (state.keyPicked[k]) {
 								glm::vec3 holdPos = eye + forward * 0.5f + glm::vec3(0.0f, 0.0f, -0.1f);
 								keyModel = glm::translate(keyModel, holdPos);
 								keyModel = glm::rotate(
@@ -665,22 +1599,14 @@ int main(int argc, char* argv[]) {
 									glm::vec3(0, 0, 1)
 								);
 								keyModel = glm::scale(keyModel, glm::vec3(0.4f));
-								glUniformMatrix4fv(uniModel, 1, GL_FALSE, glm::value_ptr(keyModel));
-								glUniform1i(uniTexID, -1);
-								glm::vec3 colVec(0.5f, 0.5f, 0.5f);
-								glUniform3fv(uniColor, 1, glm::value_ptr(colVec));
-								glDrawArrays(GL_TRIANGLES, startVertTeapot, numVertsTeapot);
+								keyBatch.records.push_back(makeDrawRecord(keyModel, glm::vec3(0.5f, 0.5f, 0.5f), -1));
 								continue;
 							}
 							// else render it normally , where it is in the map
 							else {
 								keyModel = glm::translate(keyModel, glm::vec3(col + 0.5f, flippedRow + 0.5f, 0));
 								keyModel = glm::rotate(keyModel, timePast * glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 1.0f));
-								glUniformMatrix4fv(uniModel, 1, GL_FALSE, glm::value_ptr(keyModel));
-								glUniform1i(uniTexID, -1);
-								glm::vec3 colVec(0.5f, 0.5f, 0.5f);
-								glUniform3fv(uniColor, 1, glm::value_ptr(colVec));
-								glDrawArrays(GL_TRIANGLES, startVertTeapot, numVertsTeapot);
+								keyBatch.records.push_back(makeDrawRecord(keyModel, glm::vec3(0.5f, 0.5f, 0.5f), -1));
 							}
 						}
 					}
@@ -693,16 +1619,131 @@ int main(int argc, char* argv[]) {
 					glm::mat4 goalModel = glm::mat4(1.0f);
 					goalModel = glm::translate(goalModel, glm::vec3(col + 0.5f, flippedRow + 0.5f, 0));
 					goalModel = glm::scale(goalModel, glm::vec3(0.2f));
-					glUniformMatrix4fv(uniModel, 1, GL_FALSE, glm::value_ptr(goalModel));
-					glUniform1i(uniTexID, -1);
-					glm::vec3 colVec(rand01(), rand01(), rand01());
-					glUniform3fv(uniColor, 1, glm::value_ptr(colVec));
-					glDrawArrays(GL_TRIANGLES, startVertSphere, numVertsSphere);
+					goalBatch.records.push_back(makeDrawRecord(goalModel, glm::vec3(rand01(), rand01(), rand01()), -1));
 				}
 			}
 		}
 
+		// submit time covers only getting the batches to the gpu (ring map and write, or the
+		// per draw uniforms, plus the draw calls), not building them above
+		Uint64 submitStart = SDL_GetPerformanceCounter();
+		// a failed ring skips this frame's scene, the uniform program takes over from the next one
+		bool drawScene = true;
+		int frameDraws = 0;
+		if (drawSubmit.streamed && !streamFrameData(drawSubmit, view, proj, drawBatches)) {
+			drawSubmit.streamed = drawSubmit.canStream = false;
+			drawScene = false;
+		}
+		setDrawSubmitProgram(drawSubmit, texturedShader);
+
+		// FLOOR AND WALLS (prebuilt per chunk)
+		if (drawScene) {
+			frameDraws += drawMapMesh(mapMesh, drawSubmit, floorBatch, wallBatch);
+			glBindVertexArray(vao);
+			frameDraws += drawBatch(drawSubmit, doorBatch);
+			frameDraws += drawBatch(drawSubmit, keyBatch);
+			frameDraws += drawBatch(drawSubmit, goalBatch);
+		}
+		if (drawSubmit.streamed) {
+			fenceStreamFrame(drawSubmit.ring);
+		}
+		double submitMs = (SDL_GetPerformanceCounter() - submitStart) * 1000.0 / SDL_GetPerformanceFrequency();
+
+		presentSceneTarget(sceneTarget, renderWidth, renderHeight);
+
+		// MINIMAP
+		// redraws nothing unless a key, door or reloaded tile changed since last frame.
+		// drawn after the upscale so it stays sharp at any resolution scale
+		updateMinimap(minimap, map, state, screenShader);
+		drawMinimap(minimap, map, state, screenShader, screenWidth, screenHeight);
+
+		// CAPTURE
+		// both only queue a pbo readback, nothing here waits for the gpu. the render thread
+		// still copies each finished readback once, out of its pbo (counted in the stats line).
+		// a screenshot that finds every pbo busy stays requested until one frees up
+		updateFrameCapture(frameCapture, screenWidth, screenHeight);
+		if (screenshotRequested && Win2PPM(screenWidth, screenHeight)) {
+			screenshotRequested = false;
+		}
+
+		endFrameTimer(frameTimer);
+		float cpuMs = (float)((SDL_GetPerformanceCounter() - frameStart) * 1000.0 / SDL_GetPerformanceFrequency());
+
 		SDL_GL_SwapWindow(window);
+
+		// measured after the swap, nothing waits for the gpu to finish this frame
+		float frameMs = frameCost(frameTimer, cpuMs);
+		float oldScale = dynamicRes.scale;
+		DynamicResDecision decision = updateDynamicRes(dynamicRes, frameMs);
+		if (decision != DYNAMIC_RES_HOLD) {
+			printf("Resolution scale %.2f -> %.2f: average %.2f ms %s target %.2f ms\n", oldScale, dynamicRes.scale,
+				dynamicRes.lastAverageMs, decision == DYNAMIC_RES_DOWN ? "over" : "well under", dynamicRes.targetMs);
+		}
+
+		statsFrames++;
+		statsMs += frameMs;
+		statsCpuMs += cpuMs;
+		statsGpuMs += frameTimer.gpuMs;
+		statsSubmitMs += submitMs;
+		double statsSeconds = (SDL_GetPerformanceCounter() - statsStart) / (double)SDL_GetPerformanceFrequency();
+		if (DEBUG_ON && !benchLights && !benchRaycaster && statsSeconds >= 1.0) {
+			printf("%5.1f fps  %6.2f ms/frame (target %.2f)  scale %.2f %s  %dx%d -> %dx%d  %d scale changes\n",
+				statsFrames / statsSeconds, statsMs / statsFrames, dynamicRes.targetMs, dynamicRes.scale,
+				dynamicRes.enabled ? "auto" : "fixed", renderWidth, renderHeight, screenWidth, screenHeight, dynamicRes.changes);
+			if (frameTimer.supported) {
+				printf("      cpu %.2f ms/frame, gpu %.2f ms/frame\n", statsCpuMs / statsFrames, statsGpuMs / statsFrames);
+			}
+			printf("      submit %.3f ms/frame via %s, %d draw calls  (ring waits %d, %.2f ms)\n",
+				statsSubmitMs / statsFrames, drawSubmit.streamed ? "stream ring" : "uniforms", frameDraws,
+				drawSubmit.ring.stalls, drawSubmit.ring.waitMs);
+			resetStreamStats(drawSubmit.ring);
+			if (frameCapture.continuous || frameCapture.readbacks > 0) {
+				reportFrameCapture(frameCapture, statsFrames);
+			}
+			statsStart = SDL_GetPerformanceCounter();
+			statsFrames = 0;
+			statsMs = 0;
+			statsCpuMs = 0;
+			statsGpuMs = 0;
+			statsSubmitMs = 0;
+		}
+
+		if (benchLights) {
+			// wait for the gpu so the time covers the whole frame, not just submitting it
+			glFinish();
+			double ms = (SDL_GetPerformanceCounter() - frameStart) * 1000.0 / SDL_GetPerformanceFrequency();
+			if (benchFrame >= BENCH_WARMUP_FRAMES) {
+				benchFrameMs += ms;
+				benchAssignMs += assignMs;
+				benchMaxLights = std::max(benchMaxLights, clusterGrid.maxLights);
+			}
+			if (++benchFrame == BENCH_WARMUP_FRAMES + BENCH_FRAMES) {
+				printf("%8d %12.3f %12.3f %12d\n", benchLightCount, benchFrameMs / BENCH_FRAMES, benchAssignMs / BENCH_FRAMES, benchMaxLights);
+				benchFrame = 0;
+				benchFrameMs = 0;
+				benchAssignMs = 0;
+				benchMaxLights = 0;
+				benchLightCount *= 2;
+				if (benchLightCount > BENCH_MAX_LIGHTS) quit = true;
+			}
+		}
+
+		if (benchRaycaster) {
+			// the same whole frame wait as --bench-lights, then the raycaster on the same views
+			glFinish();
+			if (benchFrame >= BENCH_WARMUP_FRAMES) {
+				benchFrameMs += (SDL_GetPerformanceCounter() - frameStart) * 1000.0 / SDL_GetPerformanceFrequency();
+			}
+			if (++benchFrame == BENCH_WARMUP_FRAMES + BENCH_FRAMES) {
+				double rayMs = benchRaycastMs(map, state, renderWidth, renderHeight, BENCH_WARMUP_FRAMES, BENCH_FRAMES, pool);
+				printf("\n%dx%d, %d frames turning on the spot\n", renderWidth, renderHeight, BENCH_FRAMES);
+				printf("%10s %12s %12s\n", "renderer", "ms/frame", "fps");
+				double glMs = benchFrameMs / BENCH_FRAMES;
+				printf("%10s %12.3f %12.1f\n", "opengl", glMs, 1000.0 / glMs);
+				printf("%10s %12.3f %12.1f  (%d threads)\n", "raycast", rayMs, 1000.0 / rayMs, (int)pool.workers.size());
+				quit = true;
+			}
+		}
 	}
 
 	delete[] modelData;
@@ -712,13 +1753,27 @@ int main(int argc, char* argv[]) {
 	delete[] model4;
 
 	//Clean Up
-	glDeleteProgram(texturedShader);
+	stopThreadPool(pool);
+	freeClusterBuffers(clusterBuffers);
+	closeFileWatcher(watcher);
+	freeMapMesh(mapMesh);
+	freeMinimap(minimap);
+	freeSceneTarget(sceneTarget);
+	freeFrameTimer(frameTimer);
+	freeDrawSubmit(drawSubmit);
+	freeFrameCapture(frameCapture);
+	if (frameCapture.captures > 0 || frameCapture.screenshots > 0) {
+		reportFrameCapture(frameCapture, statsFrames);
+	}
+	glDeleteProgram(screenShader);
+	glDeleteProgram(streamedShader);
+	glDeleteProgram(uniformShader);
 	glDeleteBuffers(1, vbo);
 	glDeleteVertexArrays(1, &vao);
 
 	SDL_GL_DestroyContext(context);
 	SDL_Quit();
-	return 0;
+	return exitCode;
 }
 
 // Create a NULL-terminated string by reading the provided file
@@ -756,8 +1811,21 @@ static char* readShaderSource(const char* shaderFile) {
 	// return the string
 	return buffer;
 }
+// Give up on building a shader program. At startup there is nothing to fall back to so we exit,
+// when hot reloading we clean up and return 0 so the caller can keep the old program running
+static GLuint shaderFailed(bool exitOnError, GLuint vertex_shader, GLuint fragment_shader, char* vs_text, char* fs_text) {
+	if (exitOnError) {
+		exit(1);
+	}
+	glDeleteShader(vertex_shader);
+	glDeleteShader(fragment_shader);
+	delete[] vs_text;
+	delete[] fs_text;
+	return 0;
+}
+
 // Create a GLSL program object from vertex and fragment shader files
-GLuint InitShader(const char* vShaderFileName, const char* fShaderFileName) {
+GLuint InitShader(const char* vShaderFileName, const char* fShaderFileName, bool exitOnError) {
 	GLuint vertex_shader, fragment_shader;
 	GLchar* vs_text, * fs_text;
 	GLuint program;
@@ -776,7 +1844,7 @@ GLuint InitShader(const char* vShaderFileName, const char* fShaderFileName) {
 	// error check
 	if (vs_text == NULL) {
 		printf("Failed to read from vertex shader file %s\n", vShaderFileName);
-		exit(1);
+		return shaderFailed(exitOnError, vertex_shader, fragment_shader, vs_text, fs_text);
 	}
 	else if (DEBUG_ON) {
 		printf("Vertex Shader:\n=====================\n");
@@ -785,7 +1853,7 @@ GLuint InitShader(const char* vShaderFileName, const char* fShaderFileName) {
 	}
 	if (fs_text == NULL) {
 		printf("Failed to read from fragent shader file %s\n", fShaderFileName);
-		exit(1);
+		return shaderFailed(exitOnError, vertex_shader, fragment_shader, vs_text, fs_text);
 	}
 	else if (DEBUG_ON) {
 		printf("\nFragment Shader:\n=====================\n");
@@ -813,7 +1881,7 @@ GLuint InitShader(const char* vShaderFileName, const char* fShaderFileName) {
 			printf("error message: %s\n", logMsg);
 			delete[] logMsg;
 		}
-		exit(1);
+		return shaderFailed(exitOnError, vertex_shader, fragment_shader, vs_text, fs_text);
 	}
 
 	// Load Fragment Shader
@@ -835,7 +1903,7 @@ GLuint InitShader(const char* vShaderFileName, const char* fShaderFileName) {
 			printf("error message: %s\n", logMsg);
 			delete[] logMsg;
 		}
-		exit(1);
+		return shaderFailed(exitOnError, vertex_shader, fragment_shader, vs_text, fs_text);
 	}
 
 	// Create the program
@@ -848,5 +1916,20 @@ GLuint InitShader(const char* vShaderFileName, const char* fShaderFileName) {
 	// Link and set program to use
 	glLinkProgram(program);
 
+	GLint linked;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (!linked) {
+		printf("Shader program failed to link\n");
+		glDeleteProgram(program);
+		return shaderFailed(exitOnError, vertex_shader, fragment_shader, vs_text, fs_text);
+	}
+
+	// the program keeps its own copy of the compiled code, so the shader objects and
+	// source text can go (this matters when shaders get recompiled on every save)
+	glDeleteShader(vertex_shader);
+	glDeleteShader(fragment_shader);
+	delete[] vs_text;
+	delete[] fs_text;
+
 	return program;
 }
\ No newline at end of file
@@ -0,0 +1,418 @@
+#define _CRT_SECURE_NO_WARNINGS
+// HEADLESS SIMULATION SERVER
+// runs thousands of independent games in one process without a window or GL context, for
+// evaluating navigation bots over many scenes and seeds. every instance on the same scene
+// shares one read only copy of the map, each instance only owns its own GameState.
+//
+// build: compile headless.cpp sim.cpp thread_pool.cpp raycast.cpp frame_writer.cpp (no SDL / OpenGL needed)
+// usage: headless <scene.txt> [more scenes] [--instances N] [--threads N] [--seconds S]
+//                 [--max-steps N] [--seed N] [--bot random|greedy]
+//                 [--frames N] [--frame-dir DIR] [--frame-size WxH] [--frame-format ppm|raw]
+//                 [--bench-raycast]
+// --frames captures what the first instance sees after each of the first N rounds, drawn
+// with the software raycaster and written on a background thread (PPMs or one raw video
+// stream). --bench-raycast times the raycaster instead of playing
+#include "sim.h"
+#include "thread_pool.h"
+#include "raycast.h"
+#include "frame_writer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <chrono>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+
+// steps every instance takes per parallelFor round before the clock is checked again
+const int STEPS_PER_ROUND = 256;
+
+// read only data for one scene, shared by every instance playing it
+struct Scene {
+	std::string name;
+	Map map;
+	// steps from each tile to the goal over open tiles (doors counted as open), -1 if unreachable
+	std::vector<int> goalDistance;
+	// same thing towards each key, lines up with map.keys
+	std::vector<std::vector<int>> keyDistance;
+};
+
+struct GameInstance {
+	const Scene* scene;
+	GameState state;
+	uint32_t rng;
+	int steps = 0;       // steps taken in the current episode
+	int episodes = 0;    // finished episodes, either by reaching the goal or running out of steps
+	int wins = 0;
+	long long totalSteps = 0;
+};
+
+enum BotType {
+	BOT_RANDOM,
+	BOT_GREEDY
+};
+
+// xorshift32, cheap and good enough to drive bots
+static uint32_t nextRandom(uint32_t& state) {
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+// breadth first search out from one target tile
+static void computeDistance(const Map& map, int targetX, int targetY, std::vector<int>& distance) {
+	distance.assign(map.width * map.height, -1);
+
+	std::queue<int> open;
+	distance[targetY * map.width + targetX] = 0;
+	open.push(targetY * map.width + targetX);
+	const int dRow[4] = { -1, 1, 0, 0 };
+	const int dCol[4] = { 0, 0, -1, 1 };
+	while (!open.empty()) {
+		int cell = open.front();
+		open.pop();
+		int row = cell / map.width;
+		int col = cell % map.width;
+		for (int i = 0; i < 4; i++) {
+			int r = row + dRow[i];
+			int c = col + dCol[i];
+			if (r < 0 || r >= map.height || c < 0 || c >= map.width) continue;
+			if (map.grid[r][c] == 'W' || distance[r * map.width + c] >= 0) continue;
+			distance[r * map.width + c] = distance[cell] + 1;
+			open.push(r * map.width + c);
+		}
+	}
+}
+
+static Action randomBot(GameInstance& instance) {
+	// mostly walk forward, turning now and then
+	uint32_t r = nextRandom(instance.rng) % 8;
+	if (r < 5) return ACTION_FORWARD;
+	if (r == 5) return ACTION_BACKWARD;
+	return r == 6 ? ACTION_TURN_LEFT : ACTION_TURN_RIGHT;
+}
+
+// collect every key still on the floor, then head for the goal. each step walks towards
+// the neighbouring tile closest to the current target, with a bit of randomness so it
+// doesn't get stuck forever against a corner
+static Action greedyBot(GameInstance& instance) {
+	if (nextRandom(instance.rng) % 10 == 0) {
+		return randomBot(instance);
+	}
+	const Scene& scene = *instance.scene;
+	const Map& map = scene.map;
+	const GameState& state = instance.state;
+	int row = map.height - 1 - (int)floor(state.y);
+	int col = (int)floor(state.x);
+	if (row < 0 || row >= map.height || col < 0 || col >= map.width) {
+		return ACTION_FORWARD;
+	}
+
+	const std::vector<int>* distance = &scene.goalDistance;
+	for (size_t k = 0; k < map.keys.size(); k++) {
+		if (!state.keyPicked[k] && scene.keyDistance[k][row * map.width + col] >= 0) {
+			distance = &scene.keyDistance[k];
+			break;
+		}
+	}
+
+	int bestRow = row;
+	int bestCol = col;
+	int best = (*distance)[row * map.width + col];
+	const int dRow[4] = { -1, 1, 0, 0 };
+	const int dCol[4] = { 0, 0, -1, 1 };
+	for (int i = 0; i < 4; i++) {
+		int r = row + dRow[i];
+		int c = col + dCol[i];
+		if (r < 0 || r >= map.height || c < 0 || c >= map.width) continue;
+		int dist = (*distance)[r * map.width + c];
+		if (dist >= 0 && (best < 0 || dist < best)) {
+			best = dist;
+			bestRow = r;
+			bestCol = c;
+		}
+	}
+
+	// aim at the centre of the chosen tile. corridors are only just wider than the player,
+	// so line up with the centre of the current tile first instead of cutting the corner
+	float targetX = bestCol + 0.5f;
+	float targetY = map.height - 1 - bestRow + 0.5f;
+	float centerX = col + 0.5f;
+	float centerY = map.height - 1 - row + 0.5f;
+	if ((bestCol != col && fabsf(state.y - centerY) > 0.1f) || (bestRow != row && fabsf(state.x - centerX) > 0.1f)) {
+		targetX = centerX;
+		targetY = centerY;
+	}
+	float wantYaw = atan2f(targetY - state.y, targetX - state.x) * 180.0f / 3.14159265f;
+	float diff = fmodf(wantYaw - state.yaw, 360.0f);
+	if (diff > 180.0f) diff -= 360.0f;
+	if (diff < -180.0f) diff += 360.0f;
+	if (diff > TURN_STEP) return ACTION_TURN_LEFT;
+	if (diff < -TURN_STEP) return ACTION_TURN_RIGHT;
+	return ACTION_FORWARD;
+}
+
+// heap memory owned by one instance, on top of sizeof(GameInstance)
+static size_t instanceHeapBytes(const GameInstance& instance) {
+	// std::vector<bool> packs its bits into machine words
+	size_t wordBytes = sizeof(unsigned long);
+	size_t keyWords = (instance.state.keyPicked.capacity() + wordBytes * 8 - 1) / (wordBytes * 8);
+	size_t doorWords = (instance.state.doorUnlocked.capacity() + wordBytes * 8 - 1) / (wordBytes * 8);
+	return (keyWords + doorWords) * wordBytes;
+}
+
+static RaycastView instanceView(const GameInstance& instance, float time) {
+	RaycastView view;
+	view.x = instance.state.x;
+	view.y = instance.state.y;
+	view.yaw = instance.state.yaw;
+	view.time = time;
+	return view;
+}
+
+// frames per second of the raycaster on one view at 1, 2, 4 ... threads
+static void benchRaycast(const GameInstance& instance, int width, int height, int maxThreads) {
+	RayTexture wallTexture, doorTexture;
+	loadRayTexture("brick.bmp", wallTexture);
+	loadRayTexture("wood.bmp", doorTexture);
+	RaycastFrame frame;
+	resizeRaycastFrame(frame, width, height);
+	if (maxThreads <= 0) maxThreads = (int)std::thread::hardware_concurrency();
+
+	const int BENCH_FRAMES = 200;
+	printf("Raycasting %s at %dx%d, %d frames per run\n", instance.scene->name.c_str(), width, height, BENCH_FRAMES);
+	printf("%8s %12s %12s\n", "threads", "ms/frame", "fps");
+	for (int threads = 1; ; threads = std::min(threads * 2, maxThreads)) {
+		ThreadPool pool;
+		startThreadPool(pool, threads);
+		RaycastView view = instanceView(instance, 0);
+		renderRaycast(frame, instance.scene->map, instance.state, wallTexture, doorTexture, view, pool); // warm up
+		auto start = std::chrono::steady_clock::now();
+		for (int f = 0; f < BENCH_FRAMES; f++) {
+			// turn on the spot so every frame sees different walls
+			view.yaw = instance.state.yaw + f * 360.0f / BENCH_FRAMES;
+			renderRaycast(frame, instance.scene->map, instance.state, wallTexture, doorTexture, view, pool);
+		}
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / BENCH_FRAMES;
+		stopThreadPool(pool);
+		printf("%8d %12.3f %12.1f\n", threads, ms, 1000.0 / ms);
+		if (threads == maxThreads) break;
+	}
+}
+
+static size_t sceneBytes(const Scene& scene) {
+	size_t bytes = sizeof(Scene);
+	for (auto& row : scene.map.grid) {
+		bytes += sizeof(std::string) + row.capacity();
+	}
+	bytes += scene.map.keys.capacity() * sizeof(Key);
+	bytes += scene.map.doors.capacity() * sizeof(Door);
+	bytes += scene.goalDistance.capacity() * sizeof(int);
+	for (auto& distance : scene.keyDistance) {
+		bytes += sizeof(distance) + distance.capacity() * sizeof(int);
+	}
+	return bytes;
+}
+
+int main(int argc, char* argv[]) {
+	std::vector<std::string> sceneFiles;
+	int numInstances = 1000;
+	int numThreads = 0;
+	float seconds = 5.0f;
+	int maxSteps = 5000;
+	uint32_t seed = 1;
+	BotType bot = BOT_GREEDY;
+	int numFrames = 0;
+	std::string frameDir = ".";
+	int frameWidth = 800;
+	int frameHeight = 600;
+	bool benchRaycaster = false;
+	FrameFormat frameFormat = FRAME_PPM;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--instances" && hasValue) numInstances = atoi(argv[++i]);
+		else if (arg == "--threads" && hasValue) numThreads = atoi(argv[++i]);
+		else if (arg == "--seconds" && hasValue) seconds = (float)atof(argv[++i]);
+		else if (arg == "--max-steps" && hasValue) maxSteps = atoi(argv[++i]);
+		else if (arg == "--seed" && hasValue) seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+		else if (arg == "--frames" && hasValue) numFrames = atoi(argv[++i]);
+		else if (arg == "--frame-dir" && hasValue) frameDir = argv[++i];
+		else if (arg == "--frame-size" && hasValue) {
+			if (sscanf(argv[++i], "%dx%d", &frameWidth, &frameHeight) != 2 || frameWidth <= 0 || frameHeight <= 0) {
+				printf("ERROR: --frame-size wants WIDTHxHEIGHT, got %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (arg == "--frame-format" && hasValue) {
+			std::string name = argv[++i];
+			if (name == "ppm") frameFormat = FRAME_PPM;
+			else if (name == "raw") frameFormat = FRAME_RAW;
+			else {
+				printf("ERROR: Unknown frame format %s\n", name.c_str());
+				return 1;
+			}
+		}
+		else if (arg == "--bench-raycast") benchRaycaster = true;
+		else if (arg == "--bot" && hasValue) {
+			std::string name = argv[++i];
+			if (name == "random") bot = BOT_RANDOM;
+			else if (name == "greedy") bot = BOT_GREEDY;
+			else {
+				printf("ERROR: Unknown bot %s\n", name.c_str());
+				return 1;
+			}
+		}
+		else if (arg.rfind("--", 0) == 0) {
+			printf("ERROR: Unknown option %s\n", arg.c_str());
+			return 1;
+		}
+		else sceneFiles.push_back(arg);
+	}
+	if (sceneFiles.empty() || numInstances <= 0) {
+		printf("Need map file\n");
+		printf("usage: %s <scene.txt> [more scenes] [--instances N] [--threads N] [--seconds S] [--max-steps N] [--seed N] [--bot random|greedy]\n", argv[0]);
+		printf("       [--frames N] [--frame-dir DIR] [--frame-size WxH] [--frame-format ppm|raw] [--bench-raycast]\n");
+		return 1;
+	}
+
+	// every scene is loaded once, no matter how many instances play it
+	std::vector<std::unique_ptr<Scene>> scenes;
+	size_t sharedBytes = 0;
+	for (auto& file : sceneFiles) {
+		std::unique_ptr<Scene> scene(new Scene());
+		scene->name = file;
+		if (!loadMap(file, scene->map)) return 1;
+		if (scene->map.startX < 0 || scene->map.goalX < 0) {
+			printf("ERROR: %s needs a start (S) and a goal (G)\n", file.c_str());
+			return 1;
+		}
+		computeDistance(scene->map, scene->map.goalX, scene->map.goalY, scene->goalDistance);
+		scene->keyDistance.resize(scene->map.keys.size());
+		for (size_t k = 0; k < scene->map.keys.size(); k++) {
+			computeDistance(scene->map, scene->map.keys[k].x, scene->map.keys[k].y, scene->keyDistance[k]);
+		}
+		sharedBytes += sceneBytes(*scene);
+		scenes.push_back(std::move(scene));
+	}
+
+	// instances are dealt out round robin over the scenes, each with its own seed
+	std::vector<GameInstance> instances(numInstances);
+	for (int i = 0; i < numInstances; i++) {
+		GameInstance& instance = instances[i];
+		instance.scene = scenes[i % scenes.size()].get();
+		instance.rng = (seed + (uint32_t)i) * 2654435761u | 1u;
+		resetGame(instance.scene->map, instance.state);
+	}
+
+	if (benchRaycaster) {
+		benchRaycast(instances[0], frameWidth, frameHeight, numThreads);
+		return 0;
+	}
+
+	// frames of the first instance, rendered between rounds on the same pool
+	RayTexture wallTexture, doorTexture;
+	RaycastFrame frame;
+	FrameWriter frameWriter;
+	if (numFrames > 0) {
+		if (!loadRayTexture("brick.bmp", wallTexture) || !loadRayTexture("wood.bmp", doorTexture)) {
+			printf("Drawing flat colors for missing textures\n");
+		}
+		resizeRaycastFrame(frame, frameWidth, frameHeight);
+		startFrameWriter(frameWriter, frameDir);
+	}
+	int framesCaptured = 0;
+	double renderMs = 0;
+	double submitMs = 0;
+
+	ThreadPool pool;
+	startThreadPool(pool, numThreads);
+	printf("Running %d instances on %d scenes with %d threads for %.1f s (%s bot, max %d steps per episode)\n",
+		numInstances, (int)scenes.size(), (int)pool.workers.size(), seconds,
+		bot == BOT_RANDOM ? "random" : "greedy", maxSteps);
+
+	auto start = std::chrono::steady_clock::now();
+	double elapsed = 0;
+	while (elapsed < seconds) {
+		parallelFor(pool, 0, numInstances, [&](int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				GameInstance& instance = instances[i];
+				const Map& map = instance.scene->map;
+				for (int s = 0; s < STEPS_PER_ROUND; s++) {
+					Action action = bot == BOT_RANDOM ? randomBot(instance) : greedyBot(instance);
+					stepGame(map, instance.state, action);
+					instance.steps++;
+					if (instance.state.reachedGoal || instance.steps >= maxSteps) {
+						instance.episodes++;
+						if (instance.state.reachedGoal) instance.wins++;
+						instance.totalSteps += instance.steps;
+						instance.steps = 0;
+						resetGame(map, instance.state);
+					}
+				}
+			}
+		});
+		elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		if (framesCaptured < numFrames) {
+			const GameInstance& instance = instances[0];
+			auto renderStart = std::chrono::steady_clock::now();
+			renderRaycast(frame, instance.scene->map, instance.state, wallTexture, doorTexture, instanceView(instance, (float)elapsed), pool);
+			auto submitStart = std::chrono::steady_clock::now();
+			// the writer takes the frame's buffer without a copy, the next frame is drawn into a
+			// recycled one (the raycaster overwrites every pixel)
+			submitFrame(frameWriter, frame.pixels, frame.width, frame.height, false,
+				frameFormat == FRAME_PPM ? frameFileName(frameWriter, "frame", framesCaptured) : "");
+			takeFrameBuffer(frameWriter, frame.pixels, (size_t)frame.width * frame.height);
+			auto submitEnd = std::chrono::steady_clock::now();
+			renderMs += std::chrono::duration<double, std::milli>(submitStart - renderStart).count();
+			submitMs += std::chrono::duration<double, std::milli>(submitEnd - submitStart).count();
+			framesCaptured++;
+		}
+	}
+	stopThreadPool(pool);
+	if (numFrames > 0) {
+		stopFrameWriter(frameWriter);
+		printf("Captured %d frames to %s: %.3f ms/frame raycasting, %.3f ms/frame handing off, %.3f ms/frame writing (background), %d dropped\n",
+			framesCaptured, frameDir.c_str(), renderMs / framesCaptured, submitMs / framesCaptured,
+			frameWriter.written > 0 ? frameWriter.writeMs / frameWriter.written : 0.0, frameWriter.dropped);
+	}
+
+	long long episodes = 0;
+	long long wins = 0;
+	long long steps = 0;
+	size_t heapBytes = 0;
+	for (auto& instance : instances) {
+		episodes += instance.episodes;
+		wins += instance.wins;
+		steps += instance.totalSteps + instance.steps;
+		heapBytes += instanceHeapBytes(instance);
+	}
+
+	printf("\nCompleted episodes: %lld (%lld reached the goal, %.1f%%)\n", episodes, wins, episodes > 0 ? 100.0 * wins / episodes : 0.0);
+	printf("Episodes per second: %.1f\n", episodes / elapsed);
+	printf("Steps per second: %.0f\n", steps / elapsed);
+	printf("Per instance memory: %.1f bytes (%d struct + %.1f heap)\n",
+		sizeof(GameInstance) + (double)heapBytes / numInstances, (int)sizeof(GameInstance), (double)heapBytes / numInstances);
+	printf("Shared scene memory: %d bytes for %d scenes\n", (int)sharedBytes, (int)scenes.size());
+
+	for (auto& scene : scenes) {
+		long long sceneEpisodes = 0;
+		long long sceneWins = 0;
+		for (auto& instance : instances) {
+			if (instance.scene == scene.get()) {
+				sceneEpisodes += instance.episodes;
+				sceneWins += instance.wins;
+			}
+		}
+		printf("  %s: %lld episodes, %lld reached the goal\n", scene->name.c_str(), sceneEpisodes, sceneWins);
+	}
+	return 0;
+}
@@ -0,0 +1,281 @@
+#include "minimap.h"
+
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+
+// largest the minimap gets on screen, in pixels
+const int MINIMAP_MAX_PX = 200;
+const int MINIMAP_MARGIN_PX = 10;
+// screen shader vertex: position xy (NDC), texcoord uv, color rgb
+const int SCREEN_VERTEX_FLOATS = 7;
+
+// what a tile looks like right now. picked keys and open doors look like floor
+static unsigned char tileLook(const Map& map, const GameState& state, int row, int col) {
+	char c = map.grid[row][col];
+	if (c >= 'a' && c <= 'e') {
+		for (size_t k = 0; k < map.keys.size(); k++) {
+			if (map.keys[k].x == col && map.keys[k].y == row) {
+				return state.keyPicked[k] ? '0' : 'k';
+			}
+		}
+	}
+	if (c >= 'A' && c <= 'E') {
+		for (size_t d = 0; d < map.doors.size(); d++) {
+			if (map.doors[d].x == col && map.doors[d].y == row) {
+				return state.doorUnlocked[d] ? 'o' : 'D';
+			}
+		}
+	}
+	if (c == 'W' || c == 'G') {
+		return c;
+	}
+	return '0';
+}
+
+static void lookColor(unsigned char look, float* rgb) {
+	switch (look) {
+		case 'W': rgb[0] = 0.55f; rgb[1] = 0.25f; rgb[2] = 0.2f; break;  // brick
+		case 'k': rgb[0] = 1.0f; rgb[1] = 0.8f; rgb[2] = 0.3f; break;    // key
+		case 'D': rgb[0] = 0.45f; rgb[1] = 0.3f; rgb[2] = 0.15f; break;  // locked door, wood
+		case 'o': rgb[0] = 0.3f; rgb[1] = 0.6f; rgb[2] = 1.0f; break;    // unlocked door
+		case 'G': rgb[0] = 0.4f; rgb[1] = 1.0f; rgb[2] = 0.5f; break;    // goal
+		default: rgb[0] = 0.1f; rgb[1] = 0.1f; rgb[2] = 0.1f; break;     // floor
+	}
+}
+
+// two triangles covering (x0, y0)-(x1, y1) in NDC
+static void appendQuad(std::vector<float>& out, float x0, float y0, float x1, float y1, const float* rgb) {
+	const float corners[6][4] = {
+		{ x0, y0, 0, 0 }, { x1, y0, 1, 0 }, { x1, y1, 1, 1 },
+		{ x0, y0, 0, 0 }, { x1, y1, 1, 1 }, { x0, y1, 0, 1 },
+	};
+	for (auto& c : corners) {
+		out.insert(out.end(), { c[0], c[1], c[2], c[3], rgb[0], rgb[1], rgb[2] });
+	}
+}
+
+static void drawScreenVerts(const Minimap& minimap, const std::vector<float>& verts) {
+	glBindVertexArray(minimap.vao);
+	glBindBuffer(GL_ARRAY_BUFFER, minimap.vbo);
+	glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(float), verts.data(), GL_STREAM_DRAW);
+	glDrawArrays(GL_TRIANGLES, 0, (GLsizei)(verts.size() / SCREEN_VERTEX_FLOATS));
+}
+
+static void setupScreenAttribs(GLuint screenShader) {
+	int stride = SCREEN_VERTEX_FLOATS * sizeof(float);
+	GLint posAttrib = glGetAttribLocation(screenShader, "position");
+	glVertexAttribPointer(posAttrib, 2, GL_FLOAT, GL_FALSE, stride, 0);
+	glEnableVertexAttribArray(posAttrib);
+	GLint texAttrib = glGetAttribLocation(screenShader, "inTexcoord");
+	glVertexAttribPointer(texAttrib, 2, GL_FLOAT, GL_FALSE, stride, (void*)(2 * sizeof(float)));
+	glEnableVertexAttribArray(texAttrib);
+	GLint colAttrib = glGetAttribLocation(screenShader, "inColor");
+	glVertexAttribPointer(colAttrib, 3, GL_FLOAT, GL_FALSE, stride, (void*)(4 * sizeof(float)));
+	glEnableVertexAttribArray(colAttrib);
+}
+
+static void queueAllTiles(Minimap& minimap) {
+	minimap.drawn.assign(minimap.mapWidth * minimap.mapHeight, 0);
+	minimap.dirty.clear();
+	for (int i = 0; i < minimap.mapWidth * minimap.mapHeight; i++) {
+		minimap.dirty.push_back(i);
+	}
+}
+
+bool initMinimap(Minimap& minimap, const Map& map, GLuint screenShader) {
+	GLint maxSize;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+	maxSize = std::min(maxSize, 4096);
+
+	minimap.mapWidth = map.width;
+	minimap.mapHeight = map.height;
+	minimap.tilePx = std::max(1, std::min(8, maxSize / std::max(map.width, map.height)));
+	minimap.texWidth = map.width * minimap.tilePx;
+	minimap.texHeight = map.height * minimap.tilePx;
+
+	glGenTextures(1, &minimap.tex);
+	glBindTexture(GL_TEXTURE_2D, minimap.tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, minimap.texWidth, minimap.texHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	// nearest when magnified keeps the tile edges crisp on small maps
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glGenFramebuffers(1, &minimap.fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, minimap.fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, minimap.tex, 0);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		printf("ERROR: Minimap framebuffer incomplete (0x%x)\n", status);
+		glDeleteFramebuffers(1, &minimap.fbo);
+		glDeleteTextures(1, &minimap.tex);
+		minimap.fbo = minimap.tex = 0;
+		return false;
+	}
+
+	if (minimap.vao == 0) {
+		glGenVertexArrays(1, &minimap.vao);
+		glGenBuffers(1, &minimap.vbo);
+		glBindVertexArray(minimap.vao);
+		glBindBuffer(GL_ARRAY_BUFFER, minimap.vbo);
+		setupScreenAttribs(screenShader);
+		glBindVertexArray(0);
+	}
+
+	queueAllTiles(minimap);
+	return true;
+}
+
+void freeMinimap(Minimap& minimap) {
+	glDeleteFramebuffers(1, &minimap.fbo);
+	glDeleteTextures(1, &minimap.tex);
+	glDeleteBuffers(1, &minimap.vbo);
+	glDeleteVertexArrays(1, &minimap.vao);
+	minimap.fbo = minimap.tex = minimap.vbo = minimap.vao = 0;
+}
+
+bool reloadMinimap(Minimap& minimap, const Map& map, GLuint screenShader) {
+	if (minimap.fbo == 0 || map.width != minimap.mapWidth || map.height != minimap.mapHeight) {
+		glDeleteFramebuffers(1, &minimap.fbo);
+		glDeleteTextures(1, &minimap.tex);
+		minimap.fbo = minimap.tex = 0;
+		if (!initMinimap(minimap, map, screenShader)) {
+			printf("ERROR: Minimap switched off, no texture for the reloaded map\n");
+			return false;
+		}
+		return true;
+	}
+	// updateMinimap compares looks, so forgetting what was drawn is enough here. tiles
+	// that still look the same are skipped there
+	minimap.dirty.clear();
+	for (int i = 0; i < map.width * map.height; i++) {
+		minimap.dirty.push_back(i);
+	}
+	return true;
+}
+
+void setMinimapProgram(Minimap& minimap, GLuint screenShader) {
+	glBindVertexArray(minimap.vao);
+	glBindBuffer(GL_ARRAY_BUFFER, minimap.vbo);
+	setupScreenAttribs(screenShader);
+	glBindVertexArray(0);
+}
+
+int updateMinimap(Minimap& minimap, const Map& map, const GameState& state, GLuint screenShader) {
+	if (minimap.fbo == 0) return 0;
+
+	// keys and doors are the only tiles that change look while playing. a reload can change
+	// how many there are, reloadMinimap has queued every tile then anyway
+	if (minimap.seenKeyPicked.size() != state.keyPicked.size() || minimap.seenDoorUnlocked.size() != state.doorUnlocked.size()) {
+		minimap.seenKeyPicked = state.keyPicked;
+		minimap.seenDoorUnlocked = state.doorUnlocked;
+	}
+	for (size_t k = 0; k < map.keys.size(); k++) {
+		if (minimap.seenKeyPicked[k] == state.keyPicked[k]) continue;
+		minimap.seenKeyPicked[k] = state.keyPicked[k];
+		minimap.dirty.push_back(map.keys[k].y * map.width + map.keys[k].x);
+	}
+	for (size_t d = 0; d < map.doors.size(); d++) {
+		if (minimap.seenDoorUnlocked[d] == state.doorUnlocked[d]) continue;
+		minimap.seenDoorUnlocked[d] = state.doorUnlocked[d];
+		minimap.dirty.push_back(map.doors[d].y * map.width + map.doors[d].x);
+	}
+	if (minimap.dirty.empty()) {
+		return 0;
+	}
+
+	std::vector<float> verts;
+	int drawnTiles = 0;
+	for (int tile : minimap.dirty) {
+		int row = tile / map.width;
+		int col = tile % map.width;
+		unsigned char look = tileLook(map, state, row, col);
+		if (minimap.drawn[tile] == look) continue;
+		minimap.drawn[tile] = look;
+		drawnTiles++;
+
+		// row 0 of the grid is the top of the map, same as the 3D view
+		int flippedRow = map.height - 1 - row;
+		float x0 = 2.0f * col / map.width - 1.0f;
+		float x1 = 2.0f * (col + 1) / map.width - 1.0f;
+		float y0 = 2.0f * flippedRow / map.height - 1.0f;
+		float y1 = 2.0f * (flippedRow + 1) / map.height - 1.0f;
+		float rgb[3];
+		lookColor(look, rgb);
+		appendQuad(verts, x0, y0, x1, y1, rgb);
+	}
+	minimap.dirty.clear();
+	if (drawnTiles == 0) {
+		return 0;
+	}
+
+	// draw just the changed tiles over the cached texture
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	GLint prevFbo;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prevFbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, minimap.fbo);
+	glViewport(0, 0, minimap.texWidth, minimap.texHeight);
+	glDisable(GL_DEPTH_TEST);
+
+	glUseProgram(screenShader);
+	glUniform1i(glGetUniformLocation(screenShader, "useTexture"), 0);
+	drawScreenVerts(minimap, verts);
+
+	glEnable(GL_DEPTH_TEST);
+	glBindFramebuffer(GL_FRAMEBUFFER, prevFbo);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	return drawnTiles;
+}
+
+void drawMinimap(Minimap& minimap, const Map& map, const GameState& state, GLuint screenShader, int viewWidth, int viewHeight) {
+	if (!minimap.visible || minimap.fbo == 0) return;
+
+	// fit the map in a MINIMAP_MAX_PX box in the top right corner, keeping its shape
+	float scale = MINIMAP_MAX_PX / (float)std::max(map.width, map.height);
+	float w = map.width * scale;
+	float h = map.height * scale;
+	float px0 = viewWidth - MINIMAP_MARGIN_PX - w;
+	float py0 = viewHeight - MINIMAP_MARGIN_PX - h;
+	float x0 = 2.0f * px0 / viewWidth - 1.0f;
+	float y0 = 2.0f * py0 / viewHeight - 1.0f;
+	float x1 = 2.0f * (px0 + w) / viewWidth - 1.0f;
+	float y1 = 2.0f * (py0 + h) / viewHeight - 1.0f;
+
+	glDisable(GL_DEPTH_TEST);
+	glUseProgram(screenShader);
+
+	// cached map
+	std::vector<float> verts;
+	const float white[3] = { 1, 1, 1 };
+	appendQuad(verts, x0, y0, x1, y1, white);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, minimap.tex);
+	glUniform1i(glGetUniformLocation(screenShader, "screenTex"), 0);
+	glUniform1i(glGetUniformLocation(screenShader, "useTexture"), 1);
+	drawScreenVerts(minimap, verts);
+
+	// player marker, a small triangle pointing where the player faces. tile (row, col)
+	// covers world x in [col, col + 1], same as the texture
+	float cx = x0 + (x1 - x0) * state.x / map.width;
+	float cy = y0 + (y1 - y0) * state.y / map.height;
+	float yawRad = state.yaw * 3.14159265f / 180.0f;
+	float size = std::max(0.6f * scale, 4.0f); // pixels
+	float sx = 2.0f * size / viewWidth;
+	float sy = 2.0f * size / viewHeight;
+	const float red[3] = { 1.0f, 0.2f, 0.2f };
+	float tip[2] = { cx + cosf(yawRad) * sx, cy + sinf(yawRad) * sy };
+	float left[2] = { cx + cosf(yawRad + 2.5f) * sx * 0.7f, cy + sinf(yawRad + 2.5f) * sy * 0.7f };
+	float right[2] = { cx + cosf(yawRad - 2.5f) * sx * 0.7f, cy + sinf(yawRad - 2.5f) * sy * 0.7f };
+	verts.clear();
+	verts.insert(verts.end(), { tip[0], tip[1], 0, 0, red[0], red[1], red[2] });
+	verts.insert(verts.end(), { left[0], left[1], 0, 0, red[0], red[1], red[2] });
+	verts.insert(verts.end(), { right[0], right[1], 0, 0, red[0], red[1], red[2] });
+	glUniform1i(glGetUniformLocation(screenShader, "useTexture"), 0);
+	drawScreenVerts(minimap, verts);
+
+	glEnable(GL_DEPTH_TEST);
+}
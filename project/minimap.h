@@ -0,0 +1,43 @@
+#pragma once
+#include "glad/glad.h"
+#include <vector>
+
+#include "sim.h"
+
+// TOP DOWN MINIMAP
+// the map is drawn once into a texture (one flat colored square per tile) and only the
+// tiles whose look changed get drawn again: a key picked up, a door unlocked, or tiles
+// edited by a hot reload. every frame the cached texture is put in the corner of the
+// screen with the player marker drawn over it, which is two small draw calls.
+struct Minimap {
+	GLuint fbo = 0;
+	GLuint tex = 0;
+	int tilePx = 0;       // texture pixels per tile
+	int texWidth = 0;
+	int texHeight = 0;
+	int mapWidth = 0;
+	int mapHeight = 0;
+	GLuint vao = 0;       // scratch buffer for the quads drawn with the screen shader
+	GLuint vbo = 0;
+	// how each tile looked when it was last drawn into the texture (0 = never drawn)
+	std::vector<unsigned char> drawn;
+	std::vector<int> dirty; // tiles to draw on the next update, as row * width + col
+	// key and door state the texture was last updated with, line up with map.keys and map.doors
+	std::vector<bool> seenKeyPicked;
+	std::vector<bool> seenDoorUnlocked;
+	bool visible = true;
+};
+
+bool initMinimap(Minimap& minimap, const Map& map, GLuint screenShader);
+void freeMinimap(Minimap& minimap);
+// after a hot reload: compare every tile against the texture and queue the ones that
+// differ, or start over if the map changed size. if the new texture can't be made the
+// minimap is switched off (fbo 0) and false is returned
+bool reloadMinimap(Minimap& minimap, const Map& map, GLuint screenShader);
+// after the screen shader was recompiled, its attribute locations may have moved
+void setMinimapProgram(Minimap& minimap, GLuint screenShader);
+// queue key and door tiles whose state changed since the last call, then draw the queued
+// tiles into the texture. returns how many tiles were drawn (usually 0)
+int updateMinimap(Minimap& minimap, const Map& map, const GameState& state, GLuint screenShader);
+// cached texture plus player marker in the top right corner of the current viewport
+void drawMinimap(Minimap& minimap, const Map& map, const GameState& state, GLuint screenShader, int viewWidth, int viewHeight);
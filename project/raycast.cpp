@@ -0,0 +1,372 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include "raycast.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#define RAYCAST_SSE2 1
+#endif
+
+// same heights as the GL scene: floor slabs have their top at -0.45, wall cubes span -0.5..0.5
+const float FLOOR_Z = -0.45f;
+const float WALL_TOP_Z = 0.5f;
+const float WALL_BOTTOM_Z = -0.5f;
+const float FAR_PLANE = 100.0f;
+const float NEAR_PLANE = 0.05f;
+// same light as clustered-Vertex.glsl, only the wall faces that look towards it get diffuse
+const float AMBIENT = 0.3f;
+const float DIFFUSE = 0.577f; // dot(-lightDir, face normal) for the lit faces
+
+enum SpriteKind {
+	SPRITE_KEY,
+	SPRITE_DOOR,
+	SPRITE_GOAL
+};
+
+struct Sprite {
+	float depth;    // along the view direction
+	float screenX;  // center column
+	float z;        // world height of the center
+	float size;     // world width and height
+	SpriteKind kind;
+	uint32_t color;
+};
+
+static uint32_t packColor(float r, float g, float b) {
+	int ri = std::min(std::max((int)(r * 255.0f + 0.5f), 0), 255);
+	int gi = std::min(std::max((int)(g * 255.0f + 0.5f), 0), 255);
+	int bi = std::min(std::max((int)(b * 255.0f + 0.5f), 0), 255);
+	return 0xFF000000u | (ri << 16) | (gi << 8) | bi;
+}
+
+// shade is in 1/256ths, 256 leaves the color as is
+static inline uint32_t shadePixel(uint32_t pixel, uint32_t shade) {
+	uint32_t rb = ((pixel & 0x00FF00FFu) * shade >> 8) & 0x00FF00FFu;
+	uint32_t g = ((pixel & 0x0000FF00u) * shade >> 8) & 0x0000FF00u;
+	return 0xFF000000u | rb | g;
+}
+
+bool loadRayTexture(const std::string& filename, RayTexture& texture) {
+	FILE* file = fopen(filename.c_str(), "rb");
+	if (!file) {
+		printf("ERROR: Could not open %s\n", filename.c_str());
+		return false;
+	}
+	std::vector<unsigned char> data;
+	unsigned char buffer[4096];
+	size_t got;
+	while ((got = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		data.insert(data.end(), buffer, buffer + got);
+	}
+	fclose(file);
+
+	auto read32 = [&](size_t at) { return (int32_t)(data[at] | data[at + 1] << 8 | data[at + 2] << 16 | (uint32_t)data[at + 3] << 24); };
+	auto read16 = [&](size_t at) { return (int)(data[at] | data[at + 1] << 8); };
+	if (data.size() < 54 || data[0] != 'B' || data[1] != 'M') {
+		printf("ERROR: %s is not a BMP\n", filename.c_str());
+		return false;
+	}
+	size_t pixelOffset = (size_t)read32(10);
+	int width = read32(18);
+	int height = read32(22);
+	int bitsPerPixel = read16(28);
+	int compression = read32(30);
+	bool topDown = height < 0;
+	height = std::abs(height);
+	// 32 bit BMPs often say BI_BITFIELDS but still store plain BGRA
+	if ((bitsPerPixel != 24 && bitsPerPixel != 32) || (compression != 0 && !(compression == 3 && bitsPerPixel == 32)) || width <= 0 || height == 0) {
+		printf("ERROR: %s must be an uncompressed 24 or 32 bit BMP\n", filename.c_str());
+		return false;
+	}
+	size_t rowBytes = ((size_t)width * bitsPerPixel + 31) / 32 * 4;
+	if (pixelOffset + rowBytes * height > data.size()) {
+		printf("ERROR: %s is truncated\n", filename.c_str());
+		return false;
+	}
+
+	texture.width = width;
+	texture.height = height;
+	texture.texels.resize((size_t)width * height);
+	int pixelBytes = bitsPerPixel / 8;
+	for (int y = 0; y < height; y++) {
+		const unsigned char* row = &data[pixelOffset + rowBytes * (topDown ? y : height - 1 - y)];
+		for (int x = 0; x < width; x++) {
+			const unsigned char* p = row + x * pixelBytes;
+			texture.texels[(size_t)x * height + y] = 0xFF000000u | p[2] << 16 | p[1] << 8 | p[0];
+		}
+	}
+	return true;
+}
+
+void resizeRaycastFrame(RaycastFrame& frame, int width, int height) {
+	if (frame.width == width && frame.height == height) return;
+	frame.width = width;
+	frame.height = height;
+	int paddedWidth = (width + 3) / 4 * 4;
+	frame.pixels.assign((size_t)width * height, 0);
+	frame.columns.assign((size_t)paddedWidth * height, 0);
+	frame.depth.assign(paddedWidth, FAR_PLANE);
+}
+
+// texPos is the texel row of the first pixel, step how far it moves per pixel
+static void fillWallSpan(uint32_t* out, int count, const uint32_t* texColumn, int texHeight, float texPos, float step, uint32_t shade) {
+	int i = 0;
+#ifdef RAYCAST_SSE2
+	// four pixels at a time: texel rows, clamp and shade in SSE registers, only the texel
+	// loads themselves are scalar (SSE2 has no gather)
+	__m128 pos = _mm_add_ps(_mm_set1_ps(texPos), _mm_mul_ps(_mm_set1_ps(step), _mm_setr_ps(0, 1, 2, 3)));
+	__m128 step4 = _mm_set1_ps(step * 4);
+	__m128 maxRow = _mm_set1_ps((float)(texHeight - 1));
+	__m128 zero = _mm_setzero_ps();
+	__m128i shade16 = _mm_set1_epi16((short)shade);
+	__m128i zeroi = _mm_setzero_si128();
+	__m128i alpha = _mm_set1_epi32((int)0xFF000000u);
+	alignas(16) int rows[4];
+	for (; i + 4 <= count; i += 4) {
+		__m128i row4 = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(pos, zero), maxRow));
+		_mm_store_si128((__m128i*)rows, row4);
+		__m128i texels = _mm_setr_epi32((int)texColumn[rows[0]], (int)texColumn[rows[1]], (int)texColumn[rows[2]], (int)texColumn[rows[3]]);
+		// widen the channels to 16 bits, multiply by the shade, narrow again
+		__m128i lo = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(texels, zeroi), shade16), 8);
+		__m128i hi = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(texels, zeroi), shade16), 8);
+		_mm_storeu_si128((__m128i*)(out + i), _mm_or_si128(_mm_packus_epi16(lo, hi), alpha));
+		pos = _mm_add_ps(pos, step4);
+	}
+	texPos += step * i;
+#endif
+	for (; i < count; i++) {
+		int row = std::min(std::max((int)texPos, 0), texHeight - 1);
+		out[i] = shadePixel(texColumn[row], shade);
+		texPos += step;
+	}
+}
+
+// cast the ray for one column and fill it top to bottom: sky, wall, floor
+static void renderColumn(RaycastFrame& frame, int col, const Map& map, const RayTexture& wallTexture,
+	const RaycastView& view, float focal, float forwardX, float forwardY, float rightX, float rightY) {
+	int h = frame.height;
+	uint32_t* out = &frame.columns[(size_t)col * h];
+	const uint32_t sky = packColor(0.2f, 0.4f, 0.8f);
+	const uint32_t floorColor = packColor(0.1f, 0.1f, 0.1f);
+
+	// direction through this column, scaled so its forward component is 1. distances found
+	// along it are then already the perpendicular distance, which keeps walls from bending
+	float u = (col + 0.5f - frame.width * 0.5f) / focal;
+	float dirX = forwardX + rightX * u;
+	float dirY = forwardY + rightY * u;
+
+	int cellX = (int)floorf(view.x);
+	int cellY = (int)floorf(view.y);
+	float deltaX = dirX == 0 ? 1e30f : fabsf(1.0f / dirX);
+	float deltaY = dirY == 0 ? 1e30f : fabsf(1.0f / dirY);
+	int stepX = dirX < 0 ? -1 : 1;
+	int stepY = dirY < 0 ? -1 : 1;
+	float sideX = (dirX < 0 ? view.x - cellX : cellX + 1.0f - view.x) * deltaX;
+	float sideY = (dirY < 0 ? view.y - cellY : cellY + 1.0f - view.y) * deltaY;
+
+	bool hit = false;
+	int side = 0;
+	float distance = 0;
+	while (distance < FAR_PLANE) {
+		if (sideX < sideY) {
+			distance = sideX;
+			sideX += deltaX;
+			cellX += stepX;
+			side = 0;
+		}
+		else {
+			distance = sideY;
+			sideY += deltaY;
+			cellY += stepY;
+			side = 1;
+		}
+		// y counts up from the bottom, the grid rows count down from the top
+		int row = map.height - 1 - cellY;
+		if (cellX < 0 || cellX >= map.width || row < 0 || row >= map.height) {
+			// left the map heading away from it, there is nothing more to hit
+			if ((cellX < 0 && stepX < 0) || (cellX >= map.width && stepX > 0) || (row < 0 && stepY > 0) || (row >= map.height && stepY < 0)) break;
+			continue;
+		}
+		if (map.grid[row][cellX] == 'W') {
+			hit = true;
+			break;
+		}
+	}
+	distance = std::max(distance, NEAR_PLANE);
+
+	float half = h * 0.5f;
+	if (!hit) {
+		// open edge of the map: floor up to where the ray left it, sky past that
+		frame.depth[col] = FAR_PLANE;
+		int floorStart = std::min(std::max((int)ceilf(half + (view.z - FLOOR_Z) * focal / distance - 0.5f), 0), h);
+		std::fill_n(out, floorStart, sky);
+		std::fill_n(out + floorStart, h - floorStart, floorColor);
+		return;
+	}
+	frame.depth[col] = distance;
+
+	float top = half - (WALL_TOP_Z - view.z) * focal / distance;
+	float bottom = half + (view.z - FLOOR_Z) * focal / distance;
+	int wallStart = std::min(std::max((int)ceilf(top - 0.5f), 0), h);
+	int wallEnd = std::min(std::max((int)ceilf(bottom - 0.5f), 0), h);
+
+	// where along the face the ray hit, flipped so the texture reads the same way on every face
+	float wallU = side == 0 ? view.y + distance * dirY : view.x + distance * dirX;
+	wallU -= floorf(wallU);
+	int texX = std::min((int)(wallU * wallTexture.width), wallTexture.width - 1);
+	if ((side == 0 && dirX > 0) || (side == 1 && dirY < 0)) {
+		texX = wallTexture.width - 1 - texX;
+	}
+	// faces pointing +x or -y see the sun, the same as the GL shading
+	bool lit = side == 0 ? dirX < 0 : dirY > 0;
+	uint32_t shade = (uint32_t)((AMBIENT + (lit ? DIFFUSE : 0.0f)) * 256.0f);
+
+	float texPerWorld = wallTexture.height / (WALL_TOP_Z - WALL_BOTTOM_Z);
+	float step = distance / focal * texPerWorld;
+	float texPos = (WALL_TOP_Z - view.z + (wallStart + 0.5f - half) * distance / focal) * texPerWorld;
+
+	std::fill_n(out, wallStart, sky);
+	fillWallSpan(out + wallStart, wallEnd - wallStart, &wallTexture.texels[(size_t)texX * wallTexture.height],
+		wallTexture.height, texPos, step, shade);
+	std::fill_n(out + wallEnd, h - wallEnd, floorColor);
+}
+
+// draw the part of every sprite inside columns [colBegin, colEnd), far ones first
+static void renderSprites(RaycastFrame& frame, int colBegin, int colEnd, const std::vector<Sprite>& sprites,
+	const RayTexture& doorTexture, const RaycastView& view, float focal) {
+	int h = frame.height;
+	float half = h * 0.5f;
+	const uint32_t doorShade = (uint32_t)((AMBIENT + 0.5f) * 256.0f);
+	for (const Sprite& sprite : sprites) {
+		float sizePx = sprite.size * focal / sprite.depth;
+		float x0 = sprite.screenX - sizePx * 0.5f;
+		float y0 = half - (sprite.z - view.z) * focal / sprite.depth - sizePx * 0.5f;
+		int first = std::max((int)ceilf(x0 - 0.5f), colBegin);
+		int last = std::min((int)ceilf(x0 + sizePx - 0.5f), colEnd);
+		int rowFirst = std::max((int)ceilf(y0 - 0.5f), 0);
+		int rowLast = std::min((int)ceilf(y0 + sizePx - 0.5f), h);
+		for (int col = first; col < last; col++) {
+			if (sprite.depth >= frame.depth[col]) continue;
+			uint32_t* out = &frame.columns[(size_t)col * h];
+			float u = (col + 0.5f - x0) / sizePx;
+			if (sprite.kind == SPRITE_DOOR) {
+				int texX = std::min((int)(u * doorTexture.width), doorTexture.width - 1);
+				float step = doorTexture.height / sizePx;
+				fillWallSpan(out + rowFirst, rowLast - rowFirst, &doorTexture.texels[(size_t)texX * doorTexture.height],
+					doorTexture.height, (rowFirst + 0.5f - y0) * step, step, doorShade);
+				continue;
+			}
+			// keys and the goal are round
+			float du = u - 0.5f;
+			for (int y = rowFirst; y < rowLast; y++) {
+				float dv = (y + 0.5f - y0) / sizePx - 0.5f;
+				if (du * du + dv * dv < 0.25f) out[y] = sprite.color;
+			}
+		}
+	}
+}
+
+// columns [colBegin, colEnd) of the column major scratch into the row major image. colBegin
+// is a multiple of 4, so whole 4x4 blocks can be flipped in registers
+static void transposeColumns(RaycastFrame& frame, int colBegin, int colEnd) {
+	int w = frame.width;
+	int h = frame.height;
+	const uint32_t* in = frame.columns.data();
+	uint32_t* out = frame.pixels.data();
+	int col = colBegin;
+#ifdef RAYCAST_SSE2
+	for (; col + 4 <= std::min(colEnd, w); col += 4) {
+		int y = 0;
+		for (; y + 4 <= h; y += 4) {
+			__m128 c0 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(in + (size_t)(col + 0) * h + y)));
+			__m128 c1 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(in + (size_t)(col + 1) * h + y)));
+			__m128 c2 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(in + (size_t)(col + 2) * h + y)));
+			__m128 c3 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(in + (size_t)(col + 3) * h + y)));
+			_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+			_mm_storeu_si128((__m128i*)(out + (size_t)(y + 0) * w + col), _mm_castps_si128(c0));
+			_mm_storeu_si128((__m128i*)(out + (size_t)(y + 1) * w + col), _mm_castps_si128(c1));
+			_mm_storeu_si128((__m128i*)(out + (size_t)(y + 2) * w + col), _mm_castps_si128(c2));
+			_mm_storeu_si128((__m128i*)(out + (size_t)(y + 3) * w + col), _mm_castps_si128(c3));
+		}
+		for (; y < h; y++) {
+			for (int c = col; c < col + 4; c++) {
+				out[(size_t)y * w + c] = in[(size_t)c * h + y];
+			}
+		}
+	}
+#endif
+	for (; col < std::min(colEnd, w); col++) {
+		for (int y = 0; y < h; y++) {
+			out[(size_t)y * w + col] = in[(size_t)col * h + y];
+		}
+	}
+}
+
+static RayTexture makePlainTexture(uint32_t color) {
+	RayTexture texture;
+	texture.width = texture.height = 1;
+	texture.texels.push_back(color);
+	return texture;
+}
+
+void renderRaycast(RaycastFrame& frame, const Map& map, const GameState& state, const RayTexture& wallTexture,
+	const RayTexture& doorTexture, const RaycastView& view, ThreadPool& pool) {
+	if (frame.width <= 0 || frame.height <= 0) return;
+
+	// one texel stand ins when a BMP couldn't be loaded, same colors as the minimap.
+	// built on the first call only
+	static const RayTexture plainWall = makePlainTexture(packColor(0.55f, 0.25f, 0.2f));
+	static const RayTexture plainDoor = makePlainTexture(packColor(0.45f, 0.3f, 0.15f));
+	const RayTexture& wall = wallTexture.texels.empty() ? plainWall : wallTexture;
+	const RayTexture& door = doorTexture.texels.empty() ? plainDoor : doorTexture;
+
+	float yawRad = view.yaw * 3.14159265f / 180.0f;
+	float forwardX = cosf(yawRad);
+	float forwardY = sinf(yawRad);
+	// same as glm::cross(forward, up) with z up
+	float rightX = forwardY;
+	float rightY = -forwardX;
+	float focal = frame.height * 0.5f / tanf(view.fovY * 3.14159265f / 360.0f);
+
+	// sprites, same placement and colors as the models in the GL path. held keys are left out
+	std::vector<Sprite> sprites;
+	auto addSprite = [&](float x, float y, float z, float size, SpriteKind kind, uint32_t color) {
+		float dx = x - view.x;
+		float dy = y - view.y;
+		float depth = dx * forwardX + dy * forwardY;
+		if (depth < NEAR_PLANE) return;
+		float screenX = frame.width * 0.5f + (dx * rightX + dy * rightY) / depth * focal;
+		sprites.push_back({ depth, screenX, z, size, kind, color });
+	};
+	for (size_t k = 0; k < map.keys.size(); k++) {
+		if (state.keyPicked[k]) continue;
+		addSprite(map.keys[k].x + 0.5f, map.height - 1 - map.keys[k].y + 0.5f, 0.0f, 0.4f, SPRITE_KEY, packColor(0.4f, 0.4f, 0.4f));
+	}
+	for (size_t d = 0; d < map.doors.size(); d++) {
+		if (state.doorUnlocked[d]) continue;
+		addSprite(map.doors[d].x + 0.5f, map.height - 1 - map.doors[d].y + 0.5f, 0.0f, 0.8f, SPRITE_DOOR, 0);
+	}
+	if (map.goalX >= 0) {
+		// the GL goal flickers through random colors, this cycles smoothly instead
+		uint32_t color = packColor(0.5f + 0.5f * sinf(view.time * 7.0f), 0.5f + 0.5f * sinf(view.time * 11.0f + 2.0f), 0.5f + 0.5f * sinf(view.time * 13.0f + 4.0f));
+		addSprite(map.goalX + 0.5f, map.height - 1 - map.goalY + 0.5f, 0.0f, 0.2f, SPRITE_GOAL, color);
+	}
+	std::sort(sprites.begin(), sprites.end(), [](const Sprite& a, const Sprite& b) { return a.depth > b.depth; });
+
+	// every job owns a run of 4 column groups: cast, add sprites, then write its columns out
+	int numGroups = (frame.width + 3) / 4;
+	parallelFor(pool, 0, numGroups, [&](int groupBegin, int groupEnd) {
+		int colBegin = groupBegin * 4;
+		int colEnd = groupEnd * 4;
+		for (int col = colBegin; col < colEnd; col++) {
+			renderColumn(frame, col, map, wall, view, focal, forwardX, forwardY, rightX, rightY);
+		}
+		renderSprites(frame, colBegin, std::min(colEnd, frame.width), sprites, door, view, focal);
+		transposeColumns(frame, colBegin, colEnd);
+	});
+}
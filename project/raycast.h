@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "sim.h"
+#include "thread_pool.h"
+
+// SOFTWARE RAYCAST RENDERER
+// a second renderer for machines without a usable gpu. the level is a flat grid of equal
+// height walls, so every screen column only needs one ray walked through the grid (DDA)
+// to find its wall, instead of rasterizing the cube meshes. keys, locked doors and the goal
+// are drawn as flat sprites on top, clipped against the per column wall distance.
+// columns are split over the thread pool and filled top to bottom into a column major
+// buffer, which is turned into normal rows at the end. needs no SDL or GL, so the headless
+// runner can use it too. frames are saved through frame_writer.h
+
+// pixels are 0xAARRGGBB, the same as SDL_PIXELFORMAT_ARGB8888
+struct RayTexture {
+	int width = 0;
+	int height = 0;
+	std::vector<uint32_t> texels; // column major, texels[x * height + y] with y = 0 the top row
+};
+
+struct RaycastFrame {
+	int width = 0;
+	int height = 0;
+	std::vector<uint32_t> pixels;  // row major, row 0 at the top
+	std::vector<uint32_t> columns; // column major scratch, padded to a multiple of 4 columns
+	std::vector<float> depth;      // wall distance per column, for clipping sprites
+};
+
+// camera, the same values the GL path builds its view matrix from
+struct RaycastView {
+	float x = 0;
+	float y = 0;
+	float z = 0.2f;       // eye height
+	float yaw = 90.0f;    // degrees
+	float fovY = 60.0f;   // degrees
+	float time = 0;       // seconds, animates the goal color
+};
+
+// uncompressed 24 or 32 bit BMPs only, which is what the game ships with
+bool loadRayTexture(const std::string& filename, RayTexture& texture);
+void resizeRaycastFrame(RaycastFrame& frame, int width, int height);
+// wallTexture is brick.bmp, doorTexture wood.bmp. an empty texture draws a flat color
+void renderRaycast(RaycastFrame& frame, const Map& map, const GameState& state, const RayTexture& wallTexture,
+	const RayTexture& doorTexture, const RaycastView& view, ThreadPool& pool);
@@ -0,0 +1,16 @@
+#version 150 core
+
+in vec2 texcoord;
+in vec3 color;
+
+out vec4 outColor;
+
+uniform sampler2D screenTex;
+uniform int useTexture;   // 1 = texture tinted by color, 0 = just the color
+
+void main() {
+	if (useTexture == 1)
+		outColor = vec4(texture(screenTex, texcoord).rgb * color, 1.0);
+	else
+		outColor = vec4(color, 1.0);
+}
@@ -0,0 +1,15 @@
+#version 150 core
+
+// flat 2D shapes for overlays, positions are already in normalized device coordinates
+in vec2 position;
+in vec2 inTexcoord;
+in vec3 inColor;
+
+out vec2 texcoord;
+out vec3 color;
+
+void main() {
+	gl_Position = vec4(position, 0.0, 1.0);
+	texcoord = inTexcoord;
+	color = inColor;
+}
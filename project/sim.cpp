@@ -0,0 +1,305 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include "sim.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <cmath>
+#include <algorithm>
+
+bool SIM_LOG = false;
+
+bool loadMap(const std::string filename, Map& map) {
+	// referenced https://cplusplus.com/reference/vector/vector/ for functions in vector library
+	FILE* file = fopen(filename.c_str(), "r");
+	// open file
+	if (!file) {
+		printf("ERROR: Could not open %s\n", filename.c_str());
+		return false;
+	}
+
+	// read line for width and height of the map
+	if (fscanf(file, "%d %d\n", &map.width, &map.height) != 2) {
+		printf("ERROR: Could not read map dimensions");
+		fclose(file);
+		return false;
+	}
+
+	if (SIM_LOG) printf("Map dimensions: %d x %d\n", map.width, map.height);
+	// clear vector of possible previous data, and reserve space for the grid
+	map.grid.clear();
+	map.grid.reserve(map.height);
+	map.keys.clear();
+	map.doors.clear();
+
+	char buffer[1024];
+	for (int i = 0; i < map.height; i++) {
+		if (!fgets(buffer, sizeof(buffer), file)) {
+			printf("ERROR: Failed to read row\n");
+			fclose(file);
+			return false;
+		}
+
+		buffer[strcspn(buffer, "\r\n")] = 0;
+
+		if ((int)strlen(buffer) != map.width) {
+			printf("ERROR: Row has wrong length\n");
+			fclose(file);
+			return false;
+		}
+
+		std::string row = buffer;
+		map.grid.push_back(row);
+		for (int col = 0; col < (int)row.size(); col++) {
+			char ch = row[col];
+			if (ch >= 'a' && ch <= 'e') {
+				Key key;
+				key.x = col;
+				key.y = i;
+				key.id = ch;
+				map.keys.push_back(key);
+			}
+
+			if (ch >= 'A' && ch <= 'E') {
+				Door door;
+				door.x = col;
+				door.y = i;
+				door.id = ch;
+				door.key_id = std::tolower(ch); // https://www.geeksforgeeks.org/cpp/tolower-function-in-cpp/
+				map.doors.push_back(door);
+			}
+			if (ch == 'S') {
+				map.startX = col;
+				map.startY = i;
+			}
+
+			if (ch == 'G') {
+				map.goalX = col;
+				map.goalY = i;
+			}
+		}
+		if (SIM_LOG) printf("%s\n", buffer);
+	}
+	if (SIM_LOG) {
+		printf("Number of keys: %d\n", (int)map.keys.size());
+		printf("Number of doors: %d\n", (int)map.doors.size());
+	}
+	fclose(file);
+	return true;
+
+}
+
+void resetGame(const Map& map, GameState& state) {
+	state.x = map.startX + 0.5f;
+	state.y = map.height - 1 - map.startY + 0.5f;
+	state.yaw = 90.0f;
+	state.keyPicked.assign(map.keys.size(), false);
+	state.doorUnlocked.assign(map.doors.size(), false);
+	state.reachedGoal = false;
+}
+
+bool walkable(float px, float py, const Map& map, const GameState& state) {
+	int mapRow = map.height - 1 - (int)floor(py);
+	int mapCol = (int)floor(px);
+	if (mapRow < 0 || mapRow >= map.height || mapCol < 0 || mapCol >= map.width) {
+		return false;
+	}
+	char c = map.grid[mapRow][mapCol];
+	if (c == 'W') {
+		return false;
+	}
+	if (c >= 'A' && c <= 'E') {
+		for (size_t i = 0; i < map.doors.size(); i++) {
+			if (map.doors[i].x == mapCol && map.doors[i].y == mapRow) {
+				return state.doorUnlocked[i];
+			}
+		}
+	}
+	return true;
+}
+
+// huge help from this article
+// https://learnopengl.com/In-Practice/2D-Game/Collisions/Collision-detection
+bool wallCollision(float px, float py, const Map& map, GameState& state) {
+	//printf("Coordinate of check : %f %f\n", px, py);
+	int rowMin = (int)floor(py - PLAYER_RADIUS);
+	int rowMax = (int)floor(py + PLAYER_RADIUS);
+	int colMin = (int)floor(px + PLAYER_RADIUS);
+	int colMax = (int)floor(px + PLAYER_RADIUS);
+
+	for (int r = rowMin; r <= rowMax; ++r) {
+		for (int c = colMin; c <= colMax; ++c) {
+	/*for (int r = 0; r < map.width; ++r) {
+		for (int c = 0; c < map.height; ++c) {*/
+			int mapRow = map.height - 1 - r;
+			int mapCol = c;
+
+			// treat out of bounds like collision
+			if (mapRow < 0 || mapRow >= map.height || mapCol < 0 || mapCol >= map.width) {
+				//printf("Out of bounds\n");
+				return true;
+			}
+
+
+			// WALL TILE CHECK
+			if (map.grid[mapRow][mapCol] == 'W') {
+
+				// cube bounding box
+				float cubeXMin = (float)c;
+				float cubeXMax = (float)c + 1.0f;
+				float cubeYMin = (float)r;
+				float cubeYMax = (float)r + 1.0f;
+				//printf("cubeXMin: %f cubeXMax: %f\n", cubeXMin, cubeXMax);
+				//printf("cubeYMin: %f cubeYMax: %f\n", cubeYMin, cubeYMax);
+
+				// player bounding box
+				float pxMin = px + PLAYER_RADIUS;
+				float pxMax = px - PLAYER_RADIUS;
+				float pyMin = py + PLAYER_RADIUS;
+				float pyMax = py - PLAYER_RADIUS;
+				//printf("px: %f\n", px);
+				//printf("py: %f\n", py);
+
+				if (pxMin > cubeXMin && pxMax < cubeXMax &&
+					pyMin > cubeYMin && pyMax < cubeYMax) {
+					if (SIM_LOG) printf("Collision detected\n");
+					return true;
+				}
+			}
+
+			// KEY TILE CHECK
+			if (map.grid[mapRow][mapCol] >= 'a' && map.grid[mapRow][mapCol] <= 'e') {
+				for (size_t k = 0; k < map.keys.size(); k++) {
+					const Key& key = map.keys[k];
+					if (key.id == map.grid[mapRow][mapCol]) {
+						if (!state.keyPicked[k]) {
+							state.keyPicked[k] = true;
+							if (SIM_LOG) printf("Key %c has been picked up\n", key.id);
+							return false;
+						}
+						else {
+							float keyXMin = (float)c;
+							float keyXMax = (float)c + 0.3f;
+							float keyYMin = (float)r;
+							float keyYMax = (float)r + 0.3f;
+
+							// player bounding box
+							float pxMin = px + PLAYER_RADIUS;
+							float pxMax = px - PLAYER_RADIUS;
+							float pyMin = py + PLAYER_RADIUS;
+							float pyMax = py - PLAYER_RADIUS;
+
+							if (pxMin > keyXMin && pxMax < keyXMax &&
+								pyMin > keyYMin && pyMax < keyYMax) {
+								if (SIM_LOG) printf("Key detected\n");
+								return false;
+							}
+						}
+					}
+				}
+					return false;
+			}
+
+			// DOOR TILE CHECK
+			if (map.grid[mapRow][mapCol] >= 'A' && map.grid[mapRow][mapCol] <= 'E') {
+				for (size_t d = 0; d < map.doors.size(); d++) {
+					const Door& door = map.doors[d];
+					if (door.id == map.grid[mapRow][mapCol]) {
+						for (size_t k = 0; k < map.keys.size(); k++) {
+							if (map.keys[k].id == door.key_id && state.keyPicked[k]) {
+								state.doorUnlocked[d] = true;
+								if (SIM_LOG) printf("Door has been unlocked!\n");
+								return false;
+							}
+						}
+					}
+				}
+				if (SIM_LOG) printf("Need key to open door\n");
+				return true;
+			}
+		}
+	}
+	if (SIM_LOG) printf("No collision\n");
+	return false;
+}
+
+bool atGoal(float px, float py, const Map& map) {
+	float dx = px - map.goalX;
+	float dy = py - (map.height - 1 - map.goalY + 0.5f);
+	return dx * dx + dy * dy <= 0.25f;
+}
+
+// help with keyboard / camera movement
+// https://www.researchgate.net/figure/Definition-of-pitch-roll-and-yaw-angle-for-camera-state-estimation_fig15_273225757
+bool stepGame(const Map& map, GameState& state, Action action) {
+	float dir;
+	switch (action) {
+		case ACTION_FORWARD:
+			dir = 1.0f;
+			break;
+		case ACTION_BACKWARD:
+			dir = -1.0f;
+			break;
+		// rotate camera left and right
+		case ACTION_TURN_LEFT:
+			state.yaw += TURN_STEP;
+			return false;
+		case ACTION_TURN_RIGHT:
+			state.yaw -= TURN_STEP;
+			return false;
+		default:
+			return false;
+	}
+
+	// have an attempted move and clamp the movement
+	float yawRad = state.yaw * 3.14159265f / 180.0f;
+	float attemptX = state.x + cosf(yawRad) * MOVE_STEP * dir;
+	float attemptY = state.y + sinf(yawRad) * MOVE_STEP * dir;
+	attemptX = std::min(std::max(attemptX, PLAYER_RADIUS), (float)map.width - PLAYER_RADIUS);
+	attemptY = std::min(std::max(attemptY, PLAYER_RADIUS), (float)map.height - PLAYER_RADIUS);
+	if (SIM_LOG) printf("Attempted move: x = %.3f, y = %.3f\n", attemptX, attemptY);
+
+	// if we didn't collide into anything, check if we are at the goal
+	if (wallCollision(attemptX, attemptY, map, state)) {
+		return false;
+	}
+	state.x = attemptX;
+	state.y = attemptY;
+	if (atGoal(state.x, state.y, map)) {
+		state.reachedGoal = true;
+	}
+	return true;
+}
+
+void carryOverGame(const Map& oldMap, const GameState& oldState, const Map& newMap, GameState& newState) {
+	resetGame(newMap, newState);
+
+	// a key the player is holding stays held as long as that key still exists
+	for (size_t k = 0; k < newMap.keys.size(); k++) {
+		for (size_t old = 0; old < oldMap.keys.size(); old++) {
+			if (oldMap.keys[old].id == newMap.keys[k].id && oldState.keyPicked[old]) {
+				newState.keyPicked[k] = true;
+			}
+		}
+	}
+	// doors stay open if the same door is still in the same place
+	for (size_t d = 0; d < newMap.doors.size(); d++) {
+		const Door& door = newMap.doors[d];
+		for (size_t old = 0; old < oldMap.doors.size(); old++) {
+			const Door& oldDoor = oldMap.doors[old];
+			if (oldDoor.id == door.id && oldDoor.x == door.x && oldDoor.y == door.y && oldState.doorUnlocked[old]) {
+				newState.doorUnlocked[d] = true;
+			}
+		}
+	}
+
+	// the player stays where they were unless the new layout put them inside something
+	newState.yaw = oldState.yaw;
+	if (walkable(oldState.x, oldState.y, newMap, newState)) {
+		newState.x = oldState.x;
+		newState.y = oldState.y;
+	}
+	else if (SIM_LOG) {
+		printf("Player position blocked by the new layout, moved back to start\n");
+	}
+}
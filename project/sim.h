@@ -0,0 +1,78 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// SIMULATION CORE
+// everything needed to play a map without a window or GL context: loading, movement,
+// collision and the goal check. game.cpp drives it from keyboard input, headless.cpp
+// drives thousands of copies of it from bots.
+
+const float PLAYER_RADIUS = 0.35f;
+const float MOVE_STEP = 0.05f;  // distance moved per forward/backward step
+const float TURN_STEP = 5.0f;   // degrees turned per left/right step
+
+// per move debug prints, off by default so headless runs stay quiet. the game turns them on
+extern bool SIM_LOG;
+
+// struct for keys
+struct Key {
+	int x;
+	int y;
+	char id;
+};
+
+struct Door {
+	int x;
+	int y;
+	char id;
+	char key_id;
+};
+
+// struct for storing map information. a Map never changes while it is being played, so
+// one loaded map can be shared read only between any number of games
+struct Map {
+	int width;
+	int height;
+	std::vector<std::string> grid;
+	// coordinates for start position and goal position
+	int startX = -1;
+	int startY = -1;
+	int goalX = -1;
+	int goalY = -1;
+	// for creating a grid in C++ https://stackoverflow.com/questions/61766469/create-grid-in-c
+
+	std::vector<Key> keys;
+	std::vector<Door> doors;
+};
+
+// the part of a game that changes while playing: where the player is and which keys and
+// doors have been used. keyPicked and doorUnlocked line up with map.keys and map.doors
+struct GameState {
+	float x = 0;    // player position, x is the column and y the row counted from the bottom
+	float y = 0;
+	float yaw = 90.0f; // degrees, 90 is facing +y
+	std::vector<bool> keyPicked;
+	std::vector<bool> doorUnlocked;
+	bool reachedGoal = false;
+};
+
+enum Action {
+	ACTION_NONE,
+	ACTION_FORWARD,
+	ACTION_BACKWARD,
+	ACTION_TURN_LEFT,
+	ACTION_TURN_RIGHT
+};
+
+bool loadMap(const std::string filename, Map& map);
+// put the player on the start tile with every key on the floor and every door locked
+void resetGame(const Map& map, GameState& state);
+// is (px, py) a tile the player is allowed to stand on
+bool walkable(float px, float py, const Map& map, const GameState& state);
+bool wallCollision(float px, float py, const Map& map, GameState& state);
+bool atGoal(float px, float py, const Map& map);
+// move the state of a game on oldMap over to newMap (used when a scene is hot reloaded):
+// held keys, open doors and the player position are kept wherever the new layout allows
+void carryOverGame(const Map& oldMap, const GameState& oldState, const Map& newMap, GameState& newState);
+// apply one action, returns true if it moved the player
+bool stepGame(const Map& map, GameState& state, Action action);
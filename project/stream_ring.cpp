@@ -0,0 +1,116 @@
+#include "stream_ring.h"
+
+#include <cstdio>
+#include <cstring>
+#include <SDL3/SDL.h>
+
+// give up on a fence after this long and write anyway, a stuck gpu shouldn't hang the game
+const GLuint64 FENCE_TIMEOUT_NS = 1000000000;
+
+static void deleteFences(StreamRing& ring) {
+	for (int i = 0; i < STREAM_RING_FRAMES; i++) {
+		if (ring.fences[i]) {
+			glDeleteSync(ring.fences[i]);
+			ring.fences[i] = 0;
+		}
+	}
+}
+
+bool initStreamRing(StreamRing& ring, GLenum target, size_t slotBytes, size_t tailBytes) {
+	ring.target = target;
+	GLint alignment = 1;
+	if (target == GL_UNIFORM_BUFFER) {
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	}
+	ring.alignment = alignment > 0 ? alignment : 1;
+	ring.slotBytes = streamAlignedSize(ring, slotBytes);
+	ring.tailBytes = tailBytes;
+
+	glGenBuffers(1, &ring.buffer);
+	glBindBuffer(target, ring.buffer);
+	glBufferData(target, ring.slotBytes * STREAM_RING_FRAMES + ring.tailBytes, NULL, GL_STREAM_DRAW);
+	if (glGetError() != GL_NO_ERROR) {
+		printf("ERROR: Could not allocate a %zu byte stream ring\n", ring.slotBytes * STREAM_RING_FRAMES);
+		return false;
+	}
+	return true;
+}
+
+void freeStreamRing(StreamRing& ring) {
+	if (ring.mapped) {
+		endStreamWrites(ring);
+	}
+	deleteFences(ring);
+	glDeleteBuffers(1, &ring.buffer);
+	ring.buffer = 0;
+}
+
+size_t streamAlignedSize(const StreamRing& ring, size_t bytes) {
+	return (bytes + ring.alignment - 1) / ring.alignment * ring.alignment;
+}
+
+bool beginStreamFrame(StreamRing& ring, size_t bytesNeeded) {
+	glBindBuffer(ring.target, ring.buffer);
+
+	if (bytesNeeded > ring.slotBytes) {
+		// re-specifying the storage orphans the old one, frames still in flight keep reading
+		// it and nothing has to be waited on
+		ring.slotBytes = streamAlignedSize(ring, bytesNeeded + bytesNeeded / 2);
+		glBufferData(ring.target, ring.slotBytes * STREAM_RING_FRAMES + ring.tailBytes, NULL, GL_STREAM_DRAW);
+		deleteFences(ring);
+		ring.slot = 0;
+		printf("Stream ring grown to %zu bytes per frame\n", ring.slotBytes);
+	}
+
+	GLsync& fence = ring.fences[ring.slot];
+	if (fence) {
+		// normally already signaled, the slot was last used STREAM_RING_FRAMES frames ago
+		GLenum result = glClientWaitSync(fence, 0, 0);
+		if (result == GL_TIMEOUT_EXPIRED) {
+			Uint64 waitStart = SDL_GetPerformanceCounter();
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+			ring.waitMs += (SDL_GetPerformanceCounter() - waitStart) * 1000.0 / SDL_GetPerformanceFrequency();
+			ring.stalls++;
+		}
+		if (result == GL_WAIT_FAILED || result == GL_TIMEOUT_EXPIRED) {
+			printf("ERROR: Stream ring fence wait failed (0x%x)\n", result);
+		}
+		glDeleteSync(fence);
+		fence = 0;
+	}
+
+	// the fence already did the syncing, so the driver doesn't have to
+	GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+	ring.mapped = (char*)glMapBufferRange(ring.target, ring.slot * ring.slotBytes, ring.slotBytes, access);
+	ring.used = 0;
+	if (!ring.mapped) {
+		printf("ERROR: Could not map stream ring slot %d\n", ring.slot);
+		return false;
+	}
+	return true;
+}
+
+size_t streamWrite(StreamRing& ring, const void* data, size_t bytes) {
+	size_t offset = ring.used;
+	if (bytes > 0) {
+		memcpy(ring.mapped + offset, data, bytes);
+	}
+	ring.used += streamAlignedSize(ring, bytes);
+	return ring.slot * ring.slotBytes + offset;
+}
+
+void endStreamWrites(StreamRing& ring) {
+	glBindBuffer(ring.target, ring.buffer);
+	glUnmapBuffer(ring.target);
+	ring.mapped = nullptr;
+}
+
+void fenceStreamFrame(StreamRing& ring) {
+	ring.fences[ring.slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	ring.slot = (ring.slot + 1) % STREAM_RING_FRAMES;
+}
+
+void resetStreamStats(StreamRing& ring) {
+	ring.waitMs = 0;
+	ring.stalls = 0;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "glad/glad.h"
+#include <cstddef>
+
+// STREAMING RING BUFFER
+// one buffer object split into a slot per frame in flight. each frame maps its own slot
+// unsynchronized (the driver doesn't check if the gpu is still reading it), writes everything
+// the frame needs in one go and unmaps. a fence placed after the frame's last draw tells us
+// when the slot is free again, which is only waited on when the cpu gets a full ring ahead.
+const int STREAM_RING_FRAMES = 3;
+
+struct StreamRing {
+	GLuint buffer = 0;
+	GLenum target = GL_UNIFORM_BUFFER;
+	size_t alignment = 1;   // every write starts on a multiple of this
+	size_t slotBytes = 0;
+	size_t tailBytes = 0;   // unused space after the last slot, see initStreamRing
+	GLsync fences[STREAM_RING_FRAMES] = {};
+	int slot = 0;
+	char* mapped = nullptr; // start of the current slot while mapped
+	size_t used = 0;        // bytes written into the current slot
+
+	// how long beginStreamFrame waited on fences since the last resetStreamStats
+	double waitMs = 0;
+	int stalls = 0;
+};
+
+// tailBytes keeps a binding of that size in range even when it starts at the very end of
+// the last slot (uniform blocks are bound at their full size, a batch may fill less)
+bool initStreamRing(StreamRing& ring, GLenum target, size_t slotBytes, size_t tailBytes);
+void freeStreamRing(StreamRing& ring);
+// bytes taken by a write of this size once padded to the alignment
+size_t streamAlignedSize(const StreamRing& ring, size_t bytes);
+// wait until the gpu is done with the next slot, grow the ring if bytesNeeded doesn't fit,
+// and map the slot for writing
+bool beginStreamFrame(StreamRing& ring, size_t bytesNeeded);
+// copy into the mapped slot, returns the offset of the data in the buffer
+size_t streamWrite(StreamRing& ring, const void* data, size_t bytes);
+// unmap, must happen before any draw reads the data
+void endStreamWrites(StreamRing& ring);
+// call after the last draw that reads this frame's data, moves on to the next slot
+void fenceStreamFrame(StreamRing& ring);
+void resetStreamStats(StreamRing& ring);
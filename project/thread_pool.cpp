@@ -0,0 +1,103 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+static void workerLoop(ThreadPool* pool) {
+	for (;;) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(pool->mutex);
+			pool->jobReady.wait(lock, [pool] { return pool->stopping || !pool->jobs.empty(); });
+			if (pool->jobs.empty()) {
+				return; // stopping and nothing left to do
+			}
+			job = std::move(pool->jobs.front());
+			pool->jobs.pop_front();
+		}
+
+		job();
+
+		std::lock_guard<std::mutex> lock(pool->mutex);
+		if (--pool->busy == 0) {
+			pool->jobsDone.notify_all();
+		}
+	}
+}
+
+void startThreadPool(ThreadPool& pool, int numThreads) {
+	if (numThreads <= 0) {
+		numThreads = std::max(1, (int)std::thread::hardware_concurrency());
+	}
+	pool.stopping = false;
+	for (int i = 0; i < numThreads; i++) {
+		pool.workers.emplace_back(workerLoop, &pool);
+	}
+}
+
+void submitJob(ThreadPool& pool, std::function<void()> job) {
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		pool.jobs.push_back(std::move(job));
+		pool.busy++;
+	}
+	pool.jobReady.notify_one();
+}
+
+void waitForJobs(ThreadPool& pool) {
+	std::unique_lock<std::mutex> lock(pool.mutex);
+	pool.jobsDone.wait(lock, [&pool] { return pool.busy == 0; });
+}
+
+void stopThreadPool(ThreadPool& pool) {
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		pool.stopping = true;
+	}
+	pool.jobReady.notify_all();
+	for (auto& worker : pool.workers) {
+		worker.join();
+	}
+	pool.workers.clear();
+}
+
+void parallelFor(ThreadPool& pool, int begin, int end, const std::function<void(int, int)>& body) {
+	int count = end - begin;
+	if (count <= 0) return;
+	// a few ranges per worker so one slow range doesn't leave the others idle
+	int numRanges = std::min(count, (int)pool.workers.size() * 4);
+	if (numRanges <= 1) {
+		body(begin, end);
+		return;
+	}
+	// only this call's ranges are waited for, other callers may have jobs queued too
+	int remaining = numRanges; // under pool.mutex
+	for (int i = 0; i < numRanges; i++) {
+		int rangeBegin = begin + (int)((long long)count * i / numRanges);
+		int rangeEnd = begin + (int)((long long)count * (i + 1) / numRanges);
+		submitJob(pool, [&pool, &body, &remaining, rangeBegin, rangeEnd] {
+			body(rangeBegin, rangeEnd);
+			std::lock_guard<std::mutex> lock(pool.mutex);
+			if (--remaining == 0) {
+				pool.jobsDone.notify_all();
+			}
+		});
+	}
+
+	// run queued jobs instead of just sleeping, so a parallelFor called from inside a job
+	// can't end up with every worker waiting and nobody left to do the work
+	std::unique_lock<std::mutex> lock(pool.mutex);
+	while (remaining > 0) {
+		if (pool.jobs.empty()) {
+			pool.jobsDone.wait(lock);
+			continue;
+		}
+		std::function<void()> job = std::move(pool.jobs.front());
+		pool.jobs.pop_front();
+		lock.unlock();
+		job();
+		lock.lock();
+		if (--pool.busy == 0) {
+			pool.jobsDone.notify_all();
+		}
+	}
+}
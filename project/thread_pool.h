@@ -0,0 +1,30 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// small fixed size pool of worker threads. jobs are plain std::function<void()>s
+// taken off a shared queue, parallelFor splits an index range across the workers
+struct ThreadPool {
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable jobReady;
+	std::condition_variable jobsDone;
+	int busy = 0;          // jobs queued or running
+	bool stopping = false;
+};
+
+// numThreads <= 0 means one thread per hardware thread
+void startThreadPool(ThreadPool& pool, int numThreads);
+void submitJob(ThreadPool& pool, std::function<void()> job);
+// block until every submitted job has finished, whoever submitted it
+void waitForJobs(ThreadPool& pool);
+void stopThreadPool(ThreadPool& pool);
+// run body(rangeBegin, rangeEnd) over [begin, end) split into a few ranges per worker,
+// returns once all of them are done. each index is in exactly one range. only waits for its
+// own ranges, so it can run alongside other callers or from inside a job
+void parallelFor(ThreadPool& pool, int begin, int end, const std::function<void(int, int)>& body);
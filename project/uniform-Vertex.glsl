@@ -0,0 +1,39 @@
+#version 150 core
+
+// the per draw uniform path from before the stream ring, kept as its own program so the
+// U key compares against the real old shader. the only change is texID being passed on
+// as drawTexID, since clustered-Fragment.glsl is shared with the streamed program
+
+in vec3 position;
+in vec3 inNormal;
+in vec2 inTexcoord;
+in float inAO;      // baked occlusion, 1 for models (see ao_bake.h)
+
+const vec3 inLightDir = normalize(vec3(-1, 1, -1));
+
+uniform vec3 inColor;
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 proj;
+uniform int texID;
+
+out vec3 Color;
+out vec3 vertNormal;
+out vec3 pos;       // view space, the point lights are uploaded in view space too
+out vec3 lightDir;
+out vec2 texcoord;
+out float ao;
+flat out int drawTexID;
+
+void main() {
+	Color = inColor;
+	drawTexID = texID;
+	vec4 viewPos = view * model * vec4(position, 1.0);
+	gl_Position = proj * viewPos;
+	pos = viewPos.xyz;
+	lightDir = (view * vec4(inLightDir, 0.0)).xyz;
+	vec4 norm4 = transpose(inverse(view * model)) * vec4(inNormal, 0.0);
+	vertNormal = normalize(norm4.xyz);
+	texcoord = inTexcoord;
+	ao = inAO;
+}